@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// eeprom.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __EEPROM_H
+#define __EEPROM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// data eeprom layout, byte offsets. the first word is where the fine adjustment lived
+// before the config records, it's only read now to carry it over. the resume records
+// fill the gap up to the config ring, which keeps 4 slots of the 512 bytes. a resume
+// record goes in every time the elevator is left still, a config only when it's tuned
+#define EE_PRESS_STEPS             0
+#define EE_RESUME                  4
+#define EE_CONFIG                  352
+
+// everything tunable that survives a power cycle
+typedef struct {
+    int32_t press_steps;        // whole steps from the limit switch to down, taken at 1/8
+    uint32_t start;             // level move profile, full steps
+    uint32_t speed;
+    uint32_t accel;
+    int32_t cam_edges[2][2];    // opto edge positions, usteps
+} config_t;
+
+#define CONFIG_WORDS               (sizeof(config_t) / sizeof(int32_t))
+
+// queue a word for programming, returns straight away unless the queue is full
+void eeWrite(uint32_t offset, int32_t value);
+void eeRead(uint32_t offset, int32_t *value);
+bool eeBusy(void);
+// a word has failed to program since the last configSave() began
+bool eeError(void);
+
+// newest intact record, false leaves config untouched
+bool configLoad(config_t *config);
+// next slot round, the crc goes last so a reset part way leaves the old one newest. it's
+// only queued, eeError() once eeBusy() clears says whether it went in
+void configSave(const config_t *config);
+
+// where we last sat still, state is up to the caller in the low 8 bits. false when the
+// newest record was cleared, or a reset caught its save part way
+bool resumeRead(uint8_t *state, int32_t *at);
+// next slot round, the mark goes last
+void resumeWrite(uint8_t state, int32_t at);
+// one word, before anything moves, so a reset during the move doesn't resume
+void resumeClear(void);
+
+#endif // __EEPROM_H
@@ -0,0 +1,43 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// input.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __INPUT_H
+#define __INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the fine adjustment buttons and the limit switch, sampled every SysTick so what they do
+// doesn't depend on what the loop is busy with. a level has to hold INPUT_DEBOUNCE_MS
+// more samples than not before it counts
+#define INPUT_DEBOUNCE_MS          10
+// a press still held this long is a hold, let go sooner it's a tap
+#define INPUT_LONG_MS              500
+
+typedef enum {
+    input_left = 0,      // SW0
+    input_right = 1,     // SW1
+    input_limit = 2
+} input_id_t;
+
+// only the buttons make events, the limit's changes go to myInputLimit() in main.c
+typedef enum {
+    input_press = 0,     // every debounced press
+    input_short = 1,     // let go before INPUT_LONG_MS
+    input_long = 2       // reached INPUT_LONG_MS still held, nothing follows on the release
+} input_event_t;
+
+// seeds the debouncers with how things are now, nothing is sampled before this
+void inputStart(void);
+// called from mySysTick_Handler()
+void inputSample(void);
+// the oldest button event not yet taken, false when there isn't one
+bool inputNext(input_id_t *id, input_event_t *event);
+// debounced, pressed or hit
+bool inputActive(input_id_t id);
+// no events waiting and neither button anywhere but released
+bool inputQuiet(void);
+
+#endif // __INPUT_H
@@ -1,126 +1,138 @@
-/* USER CODE BEGIN Header */
-/**
-  ******************************************************************************
-  * @file           : main.h
-  * @brief          : Header for main.c file.
-  *                   This file contains the common defines of the application.
-  ******************************************************************************
-  * @attention
-  *
-  * <h2><center>&copy; Copyright (c) 2021 STMicroelectronics.
-  * All rights reserved.</center></h2>
-  *
-  * This software component is licensed by ST under BSD 3-Clause license,
-  * the "License"; You may not use this file except in compliance with the
-  * License. You may obtain a copy of the License at:
-  *                        opensource.org/licenses/BSD-3-Clause
-  *
-  ******************************************************************************
-  */
-/* USER CODE END Header */
-
-/* Define to prevent recursive inclusion -------------------------------------*/
-#ifndef __MAIN_H
-#define __MAIN_H
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-/* Includes ------------------------------------------------------------------*/
-#include "stm32l0xx_ll_crs.h"
-#include "stm32l0xx_ll_rcc.h"
-#include "stm32l0xx_ll_bus.h"
-#include "stm32l0xx_ll_system.h"
-#include "stm32l0xx_ll_exti.h"
-#include "stm32l0xx_ll_cortex.h"
-#include "stm32l0xx_ll_utils.h"
-#include "stm32l0xx_ll_pwr.h"
-#include "stm32l0xx_ll_dma.h"
-#include "stm32l0xx_ll_gpio.h"
-
-#if defined(USE_FULL_ASSERT)
-#include "stm32_assert.h"
-#endif /* USE_FULL_ASSERT */
-
-/* Private includes ----------------------------------------------------------*/
-/* USER CODE BEGIN Includes */
-
-/* USER CODE END Includes */
-
-/* Exported types ------------------------------------------------------------*/
-/* USER CODE BEGIN ET */
-
-/* USER CODE END ET */
-
-/* Exported constants --------------------------------------------------------*/
-/* USER CODE BEGIN EC */
-
-/* USER CODE END EC */
-
-/* Exported macro ------------------------------------------------------------*/
-/* USER CODE BEGIN EM */
-
-/* USER CODE END EM */
-
-/* Exported functions prototypes ---------------------------------------------*/
-void Error_Handler(void);
-
-/* USER CODE BEGIN EFP */
-
-/* USER CODE END EFP */
-
-/* Private defines -----------------------------------------------------------*/
-#define LIMIT_Pin LL_GPIO_PIN_9
-#define LIMIT_GPIO_Port GPIOB
-#define LIMIT_EXTI_IRQn EXTI4_15_IRQn
-#define SW0_Pin LL_GPIO_PIN_14
-#define SW0_GPIO_Port GPIOC
-#define SW1_Pin LL_GPIO_PIN_15
-#define SW1_GPIO_Port GPIOC
-#define S_NFLT_Pin LL_GPIO_PIN_0
-#define S_NFLT_GPIO_Port GPIOA
-#define S_NFLT_EXTI_IRQn EXTI0_1_IRQn
-#define HOME_Pin LL_GPIO_PIN_1
-#define HOME_GPIO_Port GPIOA
-#define S_STEP_Pin LL_GPIO_PIN_2
-#define S_STEP_GPIO_Port GPIOA
-#define S_DIR_Pin LL_GPIO_PIN_3
-#define S_DIR_GPIO_Port GPIOA
-#define S_NEN_Pin LL_GPIO_PIN_4
-#define S_NEN_GPIO_Port GPIOA
-#define S_M0_Pin LL_GPIO_PIN_5
-#define S_M0_GPIO_Port GPIOA
-#define S_M1_Pin LL_GPIO_PIN_6
-#define S_M1_GPIO_Port GPIOA
-#define S_M2_Pin LL_GPIO_PIN_7
-#define S_M2_GPIO_Port GPIOA
-#define EN_Pin LL_GPIO_PIN_10
-#define EN_GPIO_Port GPIOA
-#define S_NRST_Pin LL_GPIO_PIN_9
-#define S_NRST_GPIO_Port GPIOA
-#define DIR_Pin LL_GPIO_PIN_1
-#define DIR_GPIO_Port GPIOB
-#ifndef NVIC_PRIORITYGROUP_0
-#define NVIC_PRIORITYGROUP_0         ((uint32_t)0x00000007) /*!< 0 bit  for pre-emption priority,
-                                                                 4 bits for subpriority */
-#define NVIC_PRIORITYGROUP_1         ((uint32_t)0x00000006) /*!< 1 bit  for pre-emption priority,
-                                                                 3 bits for subpriority */
-#define NVIC_PRIORITYGROUP_2         ((uint32_t)0x00000005) /*!< 2 bits for pre-emption priority,
-                                                                 2 bits for subpriority */
-#define NVIC_PRIORITYGROUP_3         ((uint32_t)0x00000004) /*!< 3 bits for pre-emption priority,
-                                                                 1 bit  for subpriority */
-#define NVIC_PRIORITYGROUP_4         ((uint32_t)0x00000003) /*!< 4 bits for pre-emption priority,
-                                                                 0 bit  for subpriority */
-#endif
-/* USER CODE BEGIN Private defines */
-
-/* USER CODE END Private defines */
-
-#ifdef __cplusplus
-}
-#endif
-
-#endif /* __MAIN_H */
-
-/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : main.h
+  * @brief          : Header for main.c file.
+  *                   This file contains the common defines of the application.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2021 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32l0xx_ll_crc.h"
+#include "stm32l0xx_ll_crs.h"
+#include "stm32l0xx_ll_rcc.h"
+#include "stm32l0xx_ll_bus.h"
+#include "stm32l0xx_ll_system.h"
+#include "stm32l0xx_ll_exti.h"
+#include "stm32l0xx_ll_cortex.h"
+#include "stm32l0xx_ll_utils.h"
+#include "stm32l0xx_ll_pwr.h"
+#include "stm32l0xx_ll_dma.h"
+#include "stm32l0xx_ll_gpio.h"
+#include "stm32l0xx_ll_lptim.h"
+#include "stm32l0xx_ll_lpuart.h"
+#include "stm32l0xx_ll_tim.h"
+#include "stm32l0xx_ll_usart.h"
+
+#if defined(USE_FULL_ASSERT)
+#include "stm32_assert.h"
+#endif /* USE_FULL_ASSERT */
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include "pins.h"
+
+/* USER CODE END Includes */
+
+/* Exported types ------------------------------------------------------------*/
+/* USER CODE BEGIN ET */
+
+/* USER CODE END ET */
+
+/* Exported constants --------------------------------------------------------*/
+/* USER CODE BEGIN EC */
+
+/* USER CODE END EC */
+
+/* Exported macro ------------------------------------------------------------*/
+/* USER CODE BEGIN EM */
+#define HAL_GPIO_ReadPin(port,pin)          LL_GPIO_IsInputPinSet(port,pin)
+#define HAL_GPIO_WritePin(port,pin,value)   pinsAssign(port, pin, PIN_IF(value, pin))
+#define HAL_GPIO_TogglePin(port,pin)        pinsToggle(port, pin)
+
+/* USER CODE END EM */
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Error_Handler(void);
+
+/* USER CODE BEGIN EFP */
+uint32_t cycles(void);
+
+/* USER CODE END EFP */
+
+/* Private defines -----------------------------------------------------------*/
+#define LIMIT_Pin LL_GPIO_PIN_9
+#define LIMIT_GPIO_Port GPIOB
+#define LIMIT_EXTI_IRQn EXTI4_15_IRQn
+#define SW0_Pin LL_GPIO_PIN_14
+#define SW0_GPIO_Port GPIOC
+#define SW1_Pin LL_GPIO_PIN_15
+#define SW1_GPIO_Port GPIOC
+#define S_NFLT_Pin LL_GPIO_PIN_0
+#define S_NFLT_GPIO_Port GPIOA
+#define S_NFLT_EXTI_IRQn EXTI0_1_IRQn
+#define HOME_Pin LL_GPIO_PIN_1
+#define HOME_GPIO_Port GPIOA
+#define S_STEP_Pin LL_GPIO_PIN_2
+#define S_STEP_GPIO_Port GPIOA
+#define S_DIR_Pin LL_GPIO_PIN_3
+#define S_DIR_GPIO_Port GPIOA
+#define S_NEN_Pin LL_GPIO_PIN_4
+#define S_NEN_GPIO_Port GPIOA
+#define S_M0_Pin LL_GPIO_PIN_5
+#define S_M0_GPIO_Port GPIOA
+#define S_M1_Pin LL_GPIO_PIN_6
+#define S_M1_GPIO_Port GPIOA
+#define S_M2_Pin LL_GPIO_PIN_7
+#define S_M2_GPIO_Port GPIOA
+#define EN_Pin LL_GPIO_PIN_10
+#define EN_GPIO_Port GPIOA
+#define EN_EXTI_IRQn EXTI4_15_IRQn
+#define S_NRST_Pin LL_GPIO_PIN_9
+#define S_NRST_GPIO_Port GPIOA
+#define DIR_Pin LL_GPIO_PIN_1
+#define DIR_GPIO_Port GPIOB
+#define DIR_EXTI_IRQn EXTI0_1_IRQn
+#ifndef NVIC_PRIORITYGROUP_0
+#define NVIC_PRIORITYGROUP_0         ((uint32_t)0x00000007) /*!< 0 bit  for pre-emption priority,
+                                                                 4 bits for subpriority */
+#define NVIC_PRIORITYGROUP_1         ((uint32_t)0x00000006) /*!< 1 bit  for pre-emption priority,
+                                                                 3 bits for subpriority */
+#define NVIC_PRIORITYGROUP_2         ((uint32_t)0x00000005) /*!< 2 bits for pre-emption priority,
+                                                                 2 bits for subpriority */
+#define NVIC_PRIORITYGROUP_3         ((uint32_t)0x00000004) /*!< 3 bits for pre-emption priority,
+                                                                 1 bit  for subpriority */
+#define NVIC_PRIORITYGROUP_4         ((uint32_t)0x00000003) /*!< 4 bits for pre-emption priority,
+                                                                 0 bit  for subpriority */
+#endif
+/* USER CODE BEGIN Private defines */
+
+/* USER CODE END Private defines */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAIN_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// pins.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PINS_H
+#define __PINS_H
+
+#include <stdint.h>
+#include "stm32l0xx_ll_gpio.h"
+
+// groups of pins on one port go out in a single BSRR store, set in the low half and reset
+// in the high half, so whatever they drive never sees a mix of old and new and the rest of
+// the port is left alone
+
+// pin if cond, for building the set of a group from a value
+#define PIN_IF(cond,pin)                    ((cond) ? (pin) : 0)
+
+static inline void pinsWrite(GPIO_TypeDef *port, uint32_t set, uint32_t reset) {
+  WRITE_REG( port->BSRR, set | (reset << 16) );
+}
+
+// the pins in mask take value, high where value has them
+static inline void pinsAssign(GPIO_TypeDef *port, uint32_t mask, uint32_t value) {
+  pinsWrite( port, value & mask, ~value & mask );
+}
+
+// flip from what the port is driving. an interrupt writing the same pins between the read
+// and the write would be undone, so they're held off for the two instructions
+static inline void pinsToggle(GPIO_TypeDef *port, uint32_t mask) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t odr = READ_REG( port->ODR );
+  pinsWrite( port, ~odr & mask, odr & mask );
+  __set_PRIMASK( primask );
+}
+
+#endif // __PINS_H
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// priority.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PRIORITY_H
+#define __PRIORITY_H
+
+// interrupt priorities, the m0+ has four and 0 is the most urgent. the step pulses are all
+// hardware, what has a deadline is keeping the timers fed
+//   0 TIM21       counter wraps and the opto compare, which sets HOME. built with
+//                 STEP_COARSE also the step size switch, which has to land before the next
+//                 pulse, a 1/32 period at 25600 pulses/s is ~39us (1250 cycles)
+//   1 TIM2        the pulses after the dma ring, each ARR written inside the period before
+//     DMA1 ch2/3  32 periods planned before the other half of the ring runs out
+//   2 EXTI0_1     nFAULT and DIR, EXTI4_15 is LIMIT, EN and the button wake. EN and DIR
+//                 both write the wpc queue so the two have to sit at the same level
+//     LPTIM1      the timebase wrap, micros() copes with it still pending
+//   3 SysTick     button sampling and the settle timer, SysTick_Config() puts it here too
+//     FLASH       eeprom writes, only ever queued while nothing moves
+//     DMA1 ch4/5  trace
+#define PRIORITY_COUNT                      0
+#define PRIORITY_STEP                       1
+#define PRIORITY_EDGE                       2
+#define PRIORITY_BACKGROUND                 3
+
+// what each handler costs and how soon it has to be done, for host/sched.c, which works out
+// every worst case response R = C + B + the longest C waiting at the same level + the sum
+// over the levels above of ceil(R/T) C, and fails the build if any R passes its D. all in
+// cycles at 32MHz
+//   C  worst case cost, counted off the handler's longest path with a wait state a fetch,
+//      ~30 to get in and out and ~120 a division. these are estimates, not yet measured on
+//      a board, the max of the PROFILE=1 region at the end of the row is what checks them
+//   T  the shortest time between two of it. the step rows take every period at the 2000
+//      steps/s tuning ceiling, 64000 pulses/s at 1/32 or 500 cycles, so a ring half is 16000
+//      and the tail 2000 with the start speed capped at 500 steps/s
+//   D  how soon it has to be done
+//   group  rows with the same non zero group never run at once, the dma ring hands over to
+//      the update interrupt from its own handler
+// and B, the longest stretch anything runs with interrupts off, in stepperOptoAt() and
+// stepperShift()
+#define SCHED_BLOCKING                      200
+
+//     handler         priority                  C          T         D  group
+#define SCHED_HANDLERS(X) \
+    X( "TIM21",        PRIORITY_COUNT,         650,     16000,     1250,     0 ) /* optoTrack, two divisions, and optoCompare, one (prof_count_isr) */ \
+    X( "DMA1 ch2",     PRIORITY_STEP,        11700,     16000,    16000,     1 ) /* 32 planReloads on the ramp, ~60 each at cruise (prof_dma_isr) */ \
+    X( "TIM2",         PRIORITY_STEP,          550,      2000,     2000,     1 ) /* planReload on the ramp and planPulses (prof_step_isr) */ \
+    X( "EXTI limit",   PRIORITY_EDGE,          450,    640000,    32000,     0 ) /* limitEdge and the opto recompare, LIMIT_LOCKOUT_US apart, inside the homing approach period (prof_exti) */ \
+    X( "EXTI fault",   PRIORITY_EDGE,          250,  32000000,    32000,     0 ) /* stepperHalt(), once a recovery (prof_exti) */ \
+    X( "EXTI EN/DIR",  PRIORITY_EDGE,          200,     16000,    32000,     0 ) /* micros() and the queue, the wpc89 drives its outputs from a 1ms irq (prof_exti) */ \
+    X( "LPTIM1",       PRIORITY_EDGE,          100,   2097152,  2097152,     0 ) /* the wrap, before the next one */ \
+    X( "SysTick",      PRIORITY_BACKGROUND,    200,     32000,    32000,     0 ) /* three debouncers, before the next tick */ \
+    X( "FLASH",        PRIORITY_BACKGROUND,    100,    102400,   102400,     0 ) /* the next word, before this one's 3.2ms is out */ \
+    X( "DMA1 ch4",     PRIORITY_BACKGROUND,    150,      2784,    32000,     0 ) /* the next trace block, a byte at 115200 apart */
+
+#endif // __PRIORITY_H
@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// profile.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdint.h>
+
+// the m0+ has no DWT cycle counter, cycles() counts the SysTick reload down from systick
+// so regions are timed to the sysclock cycle. times include whatever interrupts came in
+// the middle, so a region's max is what it costs the code around it
+typedef enum {
+    prof_loop = 0,          // one main loop pass, start to start
+    prof_buttons = 1,       // taking a button event
+    prof_wpc = 2,           // wpcCommand()
+    prof_step_isr = 3,      // TIM2 update
+    prof_dma_isr = 4,       // DMA1 channel 2 half/full
+    prof_count_isr = 5,     // TIM21 wrap, opto and step size compares
+    prof_exti = 6,          // EN/DIR/limit/fault edges, both handlers share a priority
+    prof_regions
+} prof_region_t;
+
+// cycles, mean is total/count. zero an entry from the debugger to start it over
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t at;            // cycles() at the last begin, 0 when not in the region
+} profile_t;
+
+#ifdef PROFILE
+extern volatile profile_t profile[prof_regions];
+// cycles() of an empty region, already taken off every figure
+extern uint32_t profile_overhead;
+
+void profileStart(void);
+void profileBegin(prof_region_t region);
+void profileEnd(prof_region_t region);
+// end the region if it was begun and begin it again, for things that repeat
+void profileLap(prof_region_t region);
+#define PROFILE_BEGIN(region)      profileBegin(region)
+#define PROFILE_END(region)        profileEnd(region)
+#define PROFILE_LAP(region)        profileLap(region)
+#else
+#define PROFILE_BEGIN(region)      do { } while(0)
+#define PROFILE_END(region)        do { } while(0)
+#define PROFILE_LAP(region)        do { } while(0)
+#endif
+
+#endif // __PROFILE_H
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// stepper.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __STEPPER_H
+#define __STEPPER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// tuned on 6/1/2021
+/*
+stepsPerRotation:200
+stepsPerInch:632.911392
+stepsPerLevel:1107.594937
+stepsPerCamDegree:12.306610
+stepsPerPercentOfLevel: 11.07594937
+*/
+#define rodInchesPerRotation                0.316
+#define stepsPerRotation                    200
+#define stepsPerInch                        (stepsPerRotation / rodInchesPerRotation)
+#define stepsPerLevel                       ((3.5/2) * stepsPerInch )
+#define stepsPerCamDegree                   (stepsPerLevel / 90)
+#define stepsPerPercentOfLevel              (stepsPerLevel / 100)
+
+// positions are kept in 1/32 microsteps, the finest the drv8825 goes, so the same spot
+// has the same count whatever step size got it there. folded to integers at compile time
+#define USTEPS_PER_STEP                     32
+#define USTEPS_PER_ROTATION                 (stepsPerRotation * USTEPS_PER_STEP)
+#define USTEPS_PER_LEVEL                    ((int32_t)(stepsPerLevel * USTEPS_PER_STEP + 0.5))
+#define USTEPS_PER_CAM_DEGREE               ((int32_t)(stepsPerCamDegree * USTEPS_PER_STEP + 0.5))
+#define USTEPS_TO_CAM_DEGREES(p)            ((p) / USTEPS_PER_CAM_DEGREE)
+
+// TIM2 is prescaled from the 32MHz sysclock so a period is programmed in 1/4us ticks
+#define STEP_TIMER_HZ                       4000000
+#define US_TO_STEP_TICKS(us)                ((us)*(STEP_TIMER_HZ/1000000))
+// drv8825 wants at least 1.9us of high time on STEP
+#define STEP_PULSE_TICKS                    US_TO_STEP_TICKS(4)
+
+typedef enum {
+    step_dir_up = 0,
+    step_dir_down = 1
+} step_dir_t;
+
+typedef enum {
+    step_size_full  = 0,
+    step_size_half  = 1,
+    step_size_4th   = 2,
+    step_size_8th   = 3,
+    step_size_16th  = 4,
+    step_size_32nd  = 5
+}  step_size_t;
+
+typedef struct {
+    uint32_t pulses;
+    uint32_t period;    // step timer ticks from one pulse to the next
+} step_segment_t;
+
+typedef enum {
+    ramp_trapezoid = 0,
+    ramp_scurve = 1
+} ramp_t;
+
+// full steps, speed times the microstep count must stay under ~68000 pulses/s, except a
+// move at 1/32 built with STEP_COARSE, which goes as coarse as 1/4 once it's fast enough
+typedef struct {
+    uint32_t start;     // steps/s
+    uint32_t speed;     // steps/s
+    uint32_t accel;     // steps/s/s, peak for the s-curve, raised if the ramp would pass ~2.1s
+    ramp_t ramp;
+} step_profile_t;
+
+int stepSize(step_size_t sz);
+
+// absolute position, in 1/32 microsteps, at which to call myStepperOpto() from the step ISR
+void stepperOptoAt(int32_t at);
+void stepperOptoOff(void);
+int32_t stepperPosition(void);
+void stepperSetPosition(int32_t at);
+// nRESET just put the driver's indexer back to its home microstep, here
+void stepperPhaseHome(void);
+// where the rotor would be pulled to if nRESET put the indexer back home now, the nearest
+// place 4 full steps round from the last home, within 2 either way
+int32_t stepperPhaseHomeAt(void);
+// correct the position by usteps, safe while running. what's left of a planned move
+// changes to match so it still ends where it was headed, a fixed rate run doesn't
+void stepperShift(int32_t usteps);
+void stepperDirection(step_dir_t dir);
+
+// emit pulses on S_STEP every period ticks, returns immediately
+void stepperStart(uint32_t pulses, uint32_t period);
+// emit each segment in turn, the table must stay put until the run is done
+void stepperStream(const step_segment_t *segments, int count);
+// accelerate, cruise and decelerate through usteps at the current step size
+void stepperMove(uint32_t usteps, const step_profile_t *profile);
+// bring a move to a stop as soon as the profile allows, done is still called at the end
+void stepperDecelerate(void);
+void stepperStop(void);
+// stop and refuse every run until stepperResume(), for a fault
+void stepperHalt(void);
+void stepperResume(void);
+bool stepperBusy(void);
+void stepperWait(void);
+
+#endif // __STEPPER_H
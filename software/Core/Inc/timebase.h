@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// timebase.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TIMEBASE_H
+#define __TIMEBASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// LPTIM1 free running off HSI16/16, a 1MHz count that doesn't care how the sysclock,
+// the PLL or the compiler are set up
+#define TIMEBASE_HZ                1000000
+
+void timebaseStart(void);
+// us since boot, wraps after ~71 minutes so only compare through differences
+uint32_t micros(void);
+// a deadline us from now, and whether it's been reached. good for up to ~35 minutes out
+#define deadlineIn(us)             (micros() + (us))
+#define deadlinePassed(at)         ((int32_t)(micros() - (at)) >= 0)
+// wait at least us, interrupts only ever make it longer
+void delayUs(uint32_t us);
+#define delayMs(ms)                delayUs((ms)*1000)
+
+#endif // __TIMEBASE_H
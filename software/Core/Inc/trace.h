@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// trace.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdint.h>
+
+// each event goes out on USART2 TX as its code, then the us since the event before it and
+// an argument, both as little endian base 128 varints (7 bits a byte, top bit set while more
+// follow). a decoder just sums the deltas, there's no framing to find. the stream begins
+// with a trace_start whose delta is from zero, so the running sum is micros()
+typedef enum {
+    trace_start = 0,
+    trace_lost = 1,         // events dropped while the ring was full
+    trace_run = 2,          // pulses in the run
+    trace_refill = 3,       // pulses still for the dma
+    trace_decel = 4,        // pulses left once cut down to a stop
+    trace_done = 5,         // stepper position, zigzag
+    trace_home = 6,         // level HOME was set to
+    trace_en_dir = 7,       // EN<<1 | DIR as the edge left them
+    trace_command = 8,      // EN<<1 | DIR once settled
+    trace_limit = 9,        // stepper position at the switch, zigzag
+    trace_fault = 10,
+    trace_limit_level = 11, // the switch once debounced, 1 hit
+} trace_t;
+
+// signed arguments fold so small magnitudes of either sign stay short
+#define TRACE_ZIGZAG(v)            (((uint32_t)(v) << 1) ^ (uint32_t)((int32_t)(v) >> 31))
+
+#ifdef TRACE_UART
+void traceStart(void);
+// safe from any interrupt, at most 11 bytes and no waiting
+void traceEvent(trace_t event, uint32_t arg);
+#define TRACE(event,arg)           traceEvent(event, arg)
+#else
+#define TRACE(event,arg)           do { } while(0)
+#endif
+
+#endif // __TRACE_H
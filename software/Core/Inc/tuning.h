@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tuning.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TUNING_H
+#define __TUNING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "eeprom.h"
+
+// 8 byte frames both ways on LPUART1 at 115200 8N1
+//   0xA5 cmd id value(int32 little endian) ~sum(cmd..value)
+// answered with the same shape starting 0x5A, cmd has 0x80 set if it was refused.
+// id is the config_t word, 0 press_steps, 1 start, 2 speed, 3 accel, 4-7 cam edges.
+// frames are only handled while the carriage is still, the reply comes once we are
+#define TUNING_SYNC                0xA5
+#define TUNING_REPLY               0x5A
+#define TUNING_FRAME               8
+
+#define TUNING_GET                 'G'   // value ignored, reply carries it
+#define TUNING_SET                 'S'   // press_steps moves the carriage at once, the rest
+                                         // take effect on the next move
+#define TUNING_COMMIT              'C'   // write the config to eeprom, answered once it's in,
+                                         // refused if a word wouldn't program
+#define TUNING_REFUSED             0x80
+
+#ifdef TUNING_UART
+void tuningStart(void);
+// handle whatever has come in, true when a commit was asked for
+bool tuningPoll(config_t *config);
+// a config save finished, answers a commit if one is waiting
+void tuningSaved(bool ok);
+#endif
+
+#endif // __TUNING_H
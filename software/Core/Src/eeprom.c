@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// eeprom.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "eeprom.h"
+
+
+#define EEPROM_BASE_ADDR	0x08080000	
+#define FLASH_PEKEY1               ((uint32_t)0x89ABCDEFU)
+#define FLASH_PEKEY2               ((uint32_t)0x02030405U)
+#define FLASH_PRGKEY1              ((uint32_t)0x8C9DAEBFU)
+#define FLASH_PRGKEY2              ((uint32_t)0x13141516U)
+
+static void eeUnlock(void) {
+  if((FLASH->PECR & FLASH_PECR_PRGLOCK) != RESET) {
+    if((FLASH->PECR & FLASH_PECR_PELOCK) != RESET) {  
+       FLASH->PEKEYR = FLASH_PEKEY1;
+       FLASH->PEKEYR = FLASH_PEKEY2;
+    }
+    FLASH->PRGKEYR = FLASH_PRGKEY1;
+    FLASH->PRGKEYR = FLASH_PRGKEY2;  
+  }
+}
+
+static void eeLock(void) {
+  SET_BIT(FLASH->PECR, FLASH_PECR_PRGLOCK);
+}
+
+// words wait here to be programmed one at a time, each started from the end of the last.
+// the cpu still stalls on flash while the single bank is busy so nothing gets queued
+// while the stepper runs, but interrupts stay on and nothing spins
+#define EE_QUEUE_LEN               12
+
+static struct {
+    uint32_t offset;
+    int32_t value;
+} ee_queue[EE_QUEUE_LEN];
+static volatile uint8_t ee_head = 0;
+static volatile uint8_t ee_tail = 0;
+static volatile bool ee_failed = false;
+
+bool eeBusy(void) {
+  return ee_head != ee_tail;
+}
+
+static void eeStart(void) {
+  eeUnlock();
+  SET_BIT(FLASH->PECR, FLASH_PECR_EOPIE | FLASH_PECR_ERRIE);
+  *(__IO int32_t*)(EEPROM_BASE_ADDR + ee_queue[ee_tail].offset) = ee_queue[ee_tail].value;
+}
+
+bool eeError(void) {
+  return ee_failed;
+}
+
+// called from stm32l0xx_it.c when the word at the tail is done, errors has the status
+// bits if it failed. the rest still go, a config slot's crc or the resume check keeps a
+// torn record from being believed
+void myIRQ_FLASH(uint32_t errors) {
+  if ( errors ) {
+    ee_failed = true;
+  }
+  ee_tail = (ee_tail + 1u) % EE_QUEUE_LEN;
+  if ( eeBusy() ) {
+    eeStart();
+  } else {
+    CLEAR_BIT(FLASH->PECR, FLASH_PECR_EOPIE | FLASH_PECR_ERRIE);
+    eeLock();
+  }
+}
+
+void eeWrite(uint32_t offset, int32_t value)
+{
+  if ( !eeBusy() && *(__IO int32_t*)(EEPROM_BASE_ADDR + offset) == value ) {
+    // already there, save the wear
+    return;
+  }
+  while ( (ee_head + 1u) % EE_QUEUE_LEN == ee_tail );
+  __disable_irq();
+  ee_queue[ ee_head ].offset = offset;
+  ee_queue[ ee_head ].value = value;
+  bool idle = !eeBusy();
+  ee_head = (ee_head + 1u) % EE_QUEUE_LEN;
+  if ( idle ) {
+    eeStart();
+  }
+  __enable_irq();
+}
+
+void eeRead(uint32_t offset, int32_t *value)
+{
+  *value = *(__IO int32_t*)(EEPROM_BASE_ADDR + offset);
+}
+
+
+// config records go round a ring of slots after the resume records, each one a sequence
+// number, the config, and a crc32 of both from the CRC unit. a slot only gets written once
+// per lap so the wear on any word is the number of saves over the slot count
+#define EE_SIZE                    (DATA_EEPROM_END - DATA_EEPROM_BASE + 1)
+#define SLOT_WORDS                 (CONFIG_WORDS + 2)
+#define SLOT_COUNT                 ((EE_SIZE - EE_CONFIG) / (SLOT_WORDS * sizeof(int32_t)))
+
+static uint32_t config_seq = 0;
+static int config_slot = -1;
+
+static uint32_t slotOffset(int slot) {
+  return EE_CONFIG + slot * SLOT_WORDS * sizeof(int32_t);
+}
+
+static uint32_t configCrc(uint32_t seq, const int32_t *words) {
+  LL_CRC_ResetCRCCalculationUnit( CRC );
+  LL_CRC_FeedData32( CRC, seq );
+  for (unsigned i=0; i<CONFIG_WORDS; i++) {
+    LL_CRC_FeedData32( CRC, words[i] );
+  }
+  return LL_CRC_ReadData32( CRC );
+}
+
+bool configLoad(config_t *config) {
+  const __IO int32_t *newest = 0;
+  for (int slot=0; slot<(int)SLOT_COUNT; slot++) {
+    const __IO int32_t *p = (const __IO int32_t*)(EEPROM_BASE_ADDR + slotOffset( slot ));
+    uint32_t seq = p[0];
+    // never written is all zero, which can't match
+    if ( configCrc( seq, (const int32_t*)&p[1] ) != (uint32_t)p[SLOT_WORDS-1] ) {
+      continue;
+    }
+    if ( !newest || (int32_t)(seq - config_seq) > 0 ) {
+      newest = p;
+      config_seq = seq;
+      config_slot = slot;
+    }
+  }
+  if ( !newest ) {
+    return false;
+  }
+  int32_t *words = (int32_t*)config;
+  for (unsigned i=0; i<CONFIG_WORDS; i++) {
+    words[i] = newest[i+1];
+  }
+  return true;
+}
+
+void configSave(const config_t *config) {
+  const int32_t *words = (const int32_t*)config;
+  ee_failed = false;
+  config_seq++;
+  config_slot = (config_slot + 1) % SLOT_COUNT;
+  uint32_t offset = slotOffset( config_slot );
+  eeWrite( offset, config_seq );
+  for (unsigned i=0; i<CONFIG_WORDS; i++) {
+    eeWrite( offset + (i+1)*sizeof(int32_t), words[i] );
+  }
+  eeWrite( offset + (SLOT_WORDS-1)*sizeof(int32_t), configCrc( config_seq, words ) );
+}
+
+
+// the resume records go round their own ring the same way, each a position, a check and a
+// mark of magic, sequence and state. clearing only rewrites the newest mark with the next
+// sequence, which leaves its check wrong, and a save goes to the next slot with the mark
+// last, so a reset part way through a save still finds the cleared one newest. a save and
+// its clear cost a mark two writes a lap of 29 slots, so 100k cycles is ~1.4 million
+// saves, ten years of a 12 hour day with the elevator left still every other minute
+#define RESUME_MAGIC               0xE1U
+#define RESUME_WORDS               3
+#define RESUME_COUNT               ((EE_CONFIG - EE_RESUME) / (RESUME_WORDS * sizeof(int32_t)))
+
+static uint16_t resume_seq = 0;
+static uint8_t resume_slot = RESUME_COUNT - 1;
+
+static uint32_t resumeOffset(void) {
+  return EE_RESUME + resume_slot * RESUME_WORDS * sizeof(int32_t);
+}
+
+static uint32_t resumeMark(uint8_t state) {
+  return (RESUME_MAGIC << 24) | ((uint32_t)resume_seq << 8) | state;
+}
+
+bool resumeRead(uint8_t *state, int32_t *at) {
+  const __IO int32_t *newest = 0;
+  const __IO int32_t *p = (const __IO int32_t*)(EEPROM_BASE_ADDR + EE_RESUME);
+  for (unsigned slot=0; slot<RESUME_COUNT; slot++, p += RESUME_WORDS) {
+    uint32_t mark = p[2];
+    if ( (mark >> 24) != RESUME_MAGIC ) {
+      continue;
+    }
+    uint16_t seq = mark >> 8;
+    if ( !newest || (int16_t)(seq - resume_seq) > 0 ) {
+      newest = p;
+      resume_seq = seq;
+      resume_slot = slot;
+    }
+  }
+  if ( !newest || newest[1] != ~(newest[2] ^ newest[0]) ) {
+    return false;
+  }
+  *state = newest[2];
+  *at = newest[0];
+  return true;
+}
+
+void resumeWrite(uint8_t state, int32_t at) {
+  resume_seq++;
+  resume_slot = (resume_slot + 1u) % RESUME_COUNT;
+  uint32_t offset = resumeOffset();
+  uint32_t mark = resumeMark( state );
+  eeWrite( offset, at );
+  eeWrite( offset + sizeof(int32_t), ~(mark ^ at) );
+  eeWrite( offset + 2*sizeof(int32_t), mark );
+}
+
+void resumeClear(void) {
+  resume_seq++;
+  eeWrite( resumeOffset() + 2*sizeof(int32_t), resumeMark( 0 ) );
+}
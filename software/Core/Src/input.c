@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// input.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "input.h"
+
+// each input integrates its samples, up while it reads active and down while it doesn't,
+// and only changes state at either end so bounce shorter than the count never gets through.
+// button events go from the SysTick to the loop through a ring only SysTick writes the
+// head of and only the loop writes the tail of. the limit only has a level, its changes
+// go straight to myInputLimit()
+
+#define INPUT_COUNT                3
+#define INPUT_QUEUE_LEN            8
+
+static const struct {
+    GPIO_TypeDef *port;
+    uint32_t pin;
+    bool high;           // active level, the buttons ground their pin, the limit pulls high
+} inputs[INPUT_COUNT] = {
+    { SW0_GPIO_Port, SW0_Pin, false },
+    { SW1_GPIO_Port, SW1_Pin, false },
+    { LIMIT_GPIO_Port, LIMIT_Pin, true }
+};
+
+void myInputLimit(bool hit);
+
+static bool sampling = false;
+static uint8_t level[INPUT_COUNT];
+static uint16_t held[input_limit];     // the buttons, the ids before the limit
+static volatile uint8_t active = 0;
+
+static volatile uint8_t queue[INPUT_QUEUE_LEN];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+
+static bool readActive(int i) {
+  return LL_GPIO_IsInputPinSet( inputs[i].port, inputs[i].pin ) == inputs[i].high;
+}
+
+static void post(int i, input_event_t event) {
+  uint8_t next = (queue_head + 1) % INPUT_QUEUE_LEN;
+  if ( next == queue_tail ) {
+    // full, the loop has plenty queued already
+    return;
+  }
+  queue[queue_head] = (event << 2) | i;
+  queue_head = next;
+}
+
+void inputStart(void) {
+  for (int i=0; i<INPUT_COUNT; i++) {
+    if ( readActive( i ) ) {
+      level[i] = INPUT_DEBOUNCE_MS;
+      active |= 1 << i;
+    }
+  }
+  sampling = true;
+}
+
+// one sample into the integrator, true when that flipped the debounced state
+static bool debounce(int i) {
+  uint8_t n = level[i];
+  if ( readActive( i ) ) {
+    n += ( n < INPUT_DEBOUNCE_MS );
+  } else {
+    n -= ( n > 0 );
+  }
+  level[i] = n;
+
+  // at either end it reads as that end, anywhere between it stays as it was
+  bool was = inputActive( i );
+  bool now = ( n == INPUT_DEBOUNCE_MS ) || ( was && n );
+  active ^= ( was != now ) << i;
+  return was != now;
+}
+
+void inputSample(void) {
+  if ( !sampling ) {
+    return;
+  }
+  for (int i=0; i<input_limit; i++) {
+    bool was = inputActive( i );
+    if ( debounce( i ) ) {
+      if ( !was ) {
+        held[i] = 0;
+        post( i, input_press );
+      } else if ( held[i] < INPUT_LONG_MS ) {
+        post( i, input_short );
+      }
+    } else if ( was && held[i] < INPUT_LONG_MS && ++held[i] == INPUT_LONG_MS ) {
+      post( i, input_long );
+    }
+  }
+  if ( debounce( input_limit ) ) {
+    myInputLimit( inputActive( input_limit ) );
+  }
+}
+
+bool inputNext(input_id_t *id, input_event_t *event) {
+  if ( queue_tail == queue_head ) {
+    return false;
+  }
+  uint8_t e = queue[queue_tail];
+  queue_tail = (queue_tail + 1) % INPUT_QUEUE_LEN;
+  *id = e & 0x03;
+  *event = e >> 2;
+  return true;
+}
+
+bool inputActive(input_id_t id) {
+  return active & (1 << id);
+}
+
+bool inputQuiet(void) {
+  return queue_tail == queue_head && level[input_left] == 0 && level[input_right] == 0;
+}
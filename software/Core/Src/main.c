@@ -1,688 +1,1507 @@
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// main.c
-// Copyright © 2021 Jeffrey Mathews All rights reserved.
-///////////////////////////////////////////////////////////////////////////////////////////////////
-
-
-#include <stdio.h>
-#include <string.h>
-#include <ctype.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <stdbool.h>
-
-#include "main.h"
-
-
-void SystemClock_Config(void);
-static void MX_GPIO_Init(void);
-
-#define HAL_GPIO_ReadPin(port,pin)          LL_GPIO_IsInputPinSet(port,pin)
-#define HAL_GPIO_WritePin(port,pin,value)   do { if(value) LL_GPIO_SetOutputPin(port,pin); else LL_GPIO_ResetOutputPin(port,pin); } while(0)
-#define HAL_GPIO_TogglePin(port,pin)        do { HAL_GPIO_WritePin(port, pin, !HAL_GPIO_ReadPin(port,pin) ); } while(0)
-
-#define HAL_GetTick()                       (systick)
-// tuned at 10s, assumes 32MHz sysclock
-#define delayUs(us)                         for (int i=0;i<us*6;i++){ asm("nop"); }
-#define delayMs(ms)                         do { delayUs((ms)*1000); } while(0)
-#define SECONDS_TO_TICKS(s)                 ((s)*1000)
-#define MINUTES_TO_TICKS(s)                 (SECONDS_TO_TICKS(s)*60)
-
-// tuned on 6/1/2021
-/*
-stepsPerRotation:200
-stepsPerInch:632.911392
-stepsPerLevel:1107.594937
-stepsPerCamDegree:12.306610
-stepsPerPercentOfLevel: 11.07594937
-*/
-#define rodInchesPerRotation                0.316
-#define stepsPerRotation                    200
-#define stepsPerInch                        (stepsPerRotation / rodInchesPerRotation) 
-#define stepsPerLevel                       ((3.5/2) * stepsPerInch )
-#define stepsPerCamDegree                   (stepsPerLevel / 90)
-#define stepsPerPercentOfLevel              (stepsPerLevel / 100)
-
-#define STEP_RAMP                           3
-#define STEP_SIZE                           500
-
-
-
-static volatile uint32_t systick = 0;
-// called from stm32l0xx_it.c weak link ISR
-void mySysTick_Handler(void) {
-  systick++;
-}
-
-bool fault = false;
-
-void myIRQ_0_1(void) {
-  // #define S_NFLT_Pin LL_GPIO_PIN_0
-  // #define S_NFLT_GPIO_Port GPIOA
-  // #define S_NFLT_EXTI_IRQn EXTI0_1_IRQn
-  fault = true;
-}
-
-void myIRQ_4_15(void) {  
-  // #define LIMIT_Pin LL_GPIO_PIN_9
-  // #define LIMIT_GPIO_Port GPIOB
-  // #define LIMIT_EXTI_IRQn EXTI4_15_IRQn
-  //fault = true;
-}
-
-
-typedef enum {
-    but_left    = 0,
-    but_right   = 1,
-    but_limit   = 2
-} button_id_t;
-
-// normally open (pulled up), grounded on closed
-typedef enum {
-    button_pressed = 0,
-    button_released = 1
-} button_t;
-
-typedef enum {
-    step_enable = 0,
-    step_disable = 1
-} step_enabled_t;
-
-typedef enum {
-    step_assert = 0,
-    step_deassert = 1
-} step_reset_t;
-
-typedef enum {
-    step_dir_up = 0,
-    step_dir_down = 1
-} step_dir_t;
-
-typedef enum {
-    step_size_full  = 0,
-    step_size_half  = 1,
-    step_size_4th   = 2,
-    step_size_8th   = 3,
-    step_size_16th  = 4,
-    step_size_32nd  = 5
-}  step_size_t;
- 
-typedef enum {
-    motor_dir_cw = 1,
-    motor_dir_ccw = 0
-} motor_dir_t;
-
-typedef enum {
-    motor_enable = 0,
-    motor_disable = 1
-} motor_enable_t;
-
-typedef enum {
-    opto_open = 1,
-    opto_closed = 0
-} opto_t;
-
-// normally open (pulled up), grounded on closed
-typedef enum {
-    limit_off = 0,
-    limit_hit = 1,
-} limit_t;
-
-typedef enum {
-    level_down  = 0,
-    level_mid_r = 1,
-    level_up    = 2,
-    level_mid_l = 3,
-} level_t;
-
-static int step_percentage = 0;
-static int step_percentage_toggle = 0;
-static level_t current_level = 0;
-
-
-static uint8_t readPin(button_id_t id) {
-  switch ( id ) {
-    case but_left:
-      return HAL_GPIO_ReadPin( SW0_GPIO_Port, SW0_Pin ); 
-    case but_right: 
-      return HAL_GPIO_ReadPin( SW1_GPIO_Port, SW1_Pin ); 
-    case but_limit: 
-      return HAL_GPIO_ReadPin( LIMIT_GPIO_Port, LIMIT_Pin ); 
-  }
-  return 0;
-}
-
-static uint32_t buttonHeldMs(button_id_t id) {
-    static uint32_t pressed[3] = {0, 0, 0};
-    static uint8_t old[3] = {button_released, button_released, button_released};
-    uint32_t ret = 0;
-    uint32_t ms = HAL_GetTick();
-    uint8_t button = readPin( id );
-    
-    if ( button != old[ id ] ) {
-      if ( button == button_pressed ) {
-        pressed[ id ] = ms;
-      } else { 
-        // button_released
-        // return how long it was held
-        ret = ms - pressed[ id ];
-      }
-    }
-    old[ id ] = button;
-    return ret;
-}
-
-
-static void stepSingle(void) {
-  delayUs( STEP_SIZE );
-  LL_GPIO_SetOutputPin( S_STEP_GPIO_Port, S_STEP_Pin );
-  delayUs( STEP_SIZE );
-  LL_GPIO_ResetOutputPin( S_STEP_GPIO_Port, S_STEP_Pin );
-  
-  static int steps = 0;
-  if ( steps++ >= stepsPerPercentOfLevel ) {
-    steps = 0;
-    step_percentage++;
-    if ( step_percentage >= step_percentage_toggle ) {
-      step_percentage_toggle = 999;
-      HAL_GPIO_TogglePin( HOME_GPIO_Port, HOME_Pin );
-    }
-  }
-}
-
-static int stepSize(step_size_t sz) {
-  HAL_GPIO_WritePin( S_M0_GPIO_Port, S_M0_Pin, sz&0x01 );
-  HAL_GPIO_WritePin( S_M1_GPIO_Port, S_M1_Pin, sz&0x02 );
-  HAL_GPIO_WritePin( S_M2_GPIO_Port, S_M2_Pin, sz&0x04 );
-  // 0=full, 1=1/2 step, 2=1/4 step, 3=1/8th step, 4=1/16th, 5,6,7=32th
-  const int m[] = {1,2,4,8,16,32};
-  return m[sz];
-}
-
-static void move(step_dir_t dir, int steps, int opto_toggle) {
-  step_percentage = 0;
-  step_percentage_toggle = opto_toggle;
-
-  HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_enable );
-  HAL_GPIO_WritePin( S_DIR_GPIO_Port, S_DIR_Pin, dir );
-  delayUs(10);
-  
-  // accelerate...
-  for (int j=5; j>=0; j--) {
-    int m = stepSize( j );
-    for (int i=0; i<m*STEP_RAMP; i++) {
-      stepSingle();
-    }
-  }
-
-  // flat
-  for (int i=STEP_RAMP*6*2; i<steps; i++) {
-    stepSingle();
-  }
-
-  // decelerate...
-  for (int j=0; j<=5; j++) {
-    int m = stepSize( j );
-    for (int i=0; i<m*STEP_RAMP; i++) {
-      stepSingle();
-    }
-  }
-}
-
-static void moveSteps( int steps, step_size_t sz ) {
-  HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_enable );
-  step_dir_t direction = (steps>0) ? step_dir_up : step_dir_down;
-  HAL_GPIO_WritePin( S_DIR_GPIO_Port, S_DIR_Pin, direction );
-  delayUs(10);
-
-  int m = stepSize( sz );
-  for (int i=0; i<abs(steps)*m; i++) {
-    stepSingle();
-  }
-}
-
-static void moveLevel( motor_dir_t direction ) {
-  static motor_dir_t last_direction = motor_dir_cw;
-  if ( direction != last_direction ) {
-    HAL_GPIO_TogglePin( HOME_GPIO_Port, HOME_Pin );
-    last_direction = direction;
-  }
-  
-  if ( direction == motor_dir_ccw ) {
-
-    // adjustments to percentages made to account for delays in moving
-    // a timer would probably work better than a percentage of the step motion
-    
-    // note: the WPC diagnostics errors correspond to the level you're going to
-
-    // CCW cam direction
-
-    switch ( current_level ) {
-      case level_down: // where you are
-        move( step_dir_up, stepsPerLevel, 5/*perc of move to open opto*/); // blocking
-        current_level = level_mid_r; // where you're going
-        break;
-      case level_mid_r:
-        move( step_dir_up, stepsPerLevel, 98/*perc of move to open opto*/);
-        current_level = level_up;
-        break;
-      case level_mid_l:
-        move( step_dir_down, stepsPerLevel, 66/*perc of move to open opto*/);
-        current_level = level_down;
-        break;
-      case level_up:
-        move( step_dir_down, stepsPerLevel, 45/*perc of move to open opto*/);
-        current_level = level_mid_l;
-        break;
-    }
-    
-  } else {
-
-    // CW cam direction
-
-    switch ( current_level ) {
-      case level_down:
-        move( step_dir_up, stepsPerLevel, 45/*perc of move to close opto*/);
-        current_level = level_mid_l;
-        break;
-      case level_mid_l:
-        move( step_dir_up, stepsPerLevel, 66/*perc of move to close opto*/);
-        current_level = level_up;
-        break;
-      case level_up:
-        move( step_dir_down, stepsPerLevel, 5/*perc of move to close opto*/);
-        current_level = level_mid_r;
-        break;
-      case level_mid_r:
-        move( step_dir_down, stepsPerLevel, 98/*perc of move to close opto*/);
-        current_level = level_down;
-        break;
-    }
-  }
-
-  // signal complete to the wpc89
-  HAL_GPIO_TogglePin( HOME_GPIO_Port, HOME_Pin );
-  
-  // stall a bit for the williams cpu to see that we completed the move
-  // allowing it to properly decide to disable or enable the dc motor enable signal
-  delayMs( 10 );
-}
-
-
-#define EEPROM_BASE_ADDR	0x08080000	
-#define FLASH_PEKEY1               ((uint32_t)0x89ABCDEFU)
-#define FLASH_PEKEY2               ((uint32_t)0x02030405U)
-#define FLASH_PRGKEY1              ((uint32_t)0x8C9DAEBFU)
-#define FLASH_PRGKEY2              ((uint32_t)0x13141516U)
-
-static void eeUnlock(void) {
-  if((FLASH->PECR & FLASH_PECR_PRGLOCK) != RESET) {
-    if((FLASH->PECR & FLASH_PECR_PELOCK) != RESET) {  
-       FLASH->PEKEYR = FLASH_PEKEY1;
-       FLASH->PEKEYR = FLASH_PEKEY2;
-    }
-    FLASH->PRGKEYR = FLASH_PRGKEY1;
-    FLASH->PRGKEYR = FLASH_PRGKEY2;  
-  }
-}
-
-static void eeLock(void) {
-  SET_BIT(FLASH->PECR, FLASH_PECR_PRGLOCK);
-}
-
-static void eeWrite(uint32_t offset, int32_t value)
-{
-  __disable_irq();
-  eeUnlock();
-  *(__IO int32_t*)(EEPROM_BASE_ADDR + offset) = value;
-  while(FLASH->SR&FLASH_SR_BSY);
-  eeLock();
-  __enable_irq();
-}
-
-static void eeRead(uint32_t offset, int32_t *value)
-{
-  *value = *(__IO int32_t*)(EEPROM_BASE_ADDR + offset);
-}
-
-
-int main(void)
-{
-  LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_SYSCFG);
-  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_PWR);
-  SystemClock_Config();
-  SysTick_Config(SystemCoreClock / 1000);
-  MX_GPIO_Init();
-  
-  // NVIC_SetPriority(LIMIT_EXTI_IRQn, 1, 0);
-  NVIC_EnableIRQ(LIMIT_EXTI_IRQn);
-  // NVIC_SetPriority(S_NFLT_EXTI_IRQn, 1, 0);
-  NVIC_EnableIRQ(S_NFLT_EXTI_IRQn);
-  
-  HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_enable );
-  HAL_GPIO_WritePin( S_NRST_GPIO_Port, S_NRST_Pin, step_deassert );
-
-  // move off the switch
-  if ( HAL_GPIO_ReadPin(LIMIT_GPIO_Port,LIMIT_Pin) == limit_hit ) {
-    moveSteps( stepsPerRotation, step_size_4th );
-  }
-
-  // find the switch at slow speed
-  stepSize( step_size_8th );
-  HAL_GPIO_WritePin( S_DIR_GPIO_Port, S_DIR_Pin, step_dir_down );
-  int ct = 0;
-  do {
-    stepSingle();
-    if ( HAL_GPIO_ReadPin(LIMIT_GPIO_Port,LIMIT_Pin) == limit_hit ) { ct++; } else { ct=0; }
-  } while ( ct < 2 ); // debounce
-
-  // and now the user's fine adjustment stored from non-voltaile
-  int32_t pressSteps = 0;
-  eeRead( 0/*offset*/, &pressSteps );
-  // // blink the press step adjustment count on the led
-  // HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_disable );
-  // delayMs(500);
-  // for (int i=0; i<pressSteps; i++) {
-  //   HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_enable );
-  //   delayMs(10);
-  //   HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_disable );
-  //   delayMs(100);
-  // }
-  moveSteps( pressSteps, step_size_8th );
-  
-  // once we zero the stepper, we can allow the machine to "home the cam"
-  // machine will try to home the to cam CW down, where opto is open at complete
-  // just to the right of the little nub on the cam
-  current_level = level_down;
-  HAL_GPIO_WritePin( HOME_GPIO_Port, HOME_Pin, opto_open );
-  HAL_GPIO_WritePin( S_DIR_GPIO_Port, S_DIR_Pin, step_dir_down );
-  
-  fault = false;
-  
-  while (1) {
-    
-    uint32_t tick = HAL_GetTick();
-    static uint32_t inactivityTimer = 0;
-
-    uint32_t press_r = buttonHeldMs( but_right );
-    uint32_t press_l = buttonHeldMs( but_left );
-    
-    if ( press_r > 10 ) {
-      inactivityTimer = tick;
-      if ( press_r > 500 ) {
-        moveLevel( motor_dir_cw );
-      } else {
-        moveSteps( 1, step_size_4th );
-        pressSteps++;
-        eeWrite( 0, pressSteps );
-      }
-    }
-    
-    if ( press_l > 10 ) {
-      inactivityTimer = tick;
-      if ( press_l > 500 ) {
-        moveLevel( motor_dir_ccw );
-      } else {
-        moveSteps( -1, step_size_4th );
-        pressSteps--;
-        eeWrite( 0, pressSteps );
-      }
-    }
-    
-    motor_enable_t enable = HAL_GPIO_ReadPin( EN_GPIO_Port, EN_Pin );
-    // note: wpc89 is only 6809 @2MHz, 2 instructions per 1us
-    // so stall a bit to allow both the enable and direction pins to stabilize
-    delayUs(10);
-    if ( enable == motor_enable ) {
-        inactivityTimer = tick;
-        motor_dir_t direction = HAL_GPIO_ReadPin( DIR_GPIO_Port, DIR_Pin );
-        moveLevel( direction );
-    }
-
-    if ( fault ) { //}|| tick-inactivityTimer > MINUTES_TO_TICKS(1)) {
-      inactivityTimer = tick;
-      HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_disable );
-    }
-          
-  }
-
-}
-
-
-
-
-/**
-  * @brief System Clock Configuration
-  * @retval None
-  */
-void SystemClock_Config(void)
-{
-  LL_FLASH_SetLatency(LL_FLASH_LATENCY_1);
-  while(LL_FLASH_GetLatency()!= LL_FLASH_LATENCY_1)
-  {
-  }
-  LL_PWR_SetRegulVoltageScaling(LL_PWR_REGU_VOLTAGE_SCALE1);
-  LL_RCC_HSI_Enable();
-
-   /* Wait till HSI is ready */
-  while(LL_RCC_HSI_IsReady() != 1)
-  {
-
-  }
-  LL_RCC_HSI_SetCalibTrimming(16);
-  LL_RCC_PLL_ConfigDomain_SYS(LL_RCC_PLLSOURCE_HSI, LL_RCC_PLL_MUL_4, LL_RCC_PLL_DIV_2);
-  LL_RCC_PLL_Enable();
-
-   /* Wait till PLL is ready */
-  while(LL_RCC_PLL_IsReady() != 1)
-  {
-
-  }
-  LL_RCC_SetAHBPrescaler(LL_RCC_SYSCLK_DIV_1);
-  LL_RCC_SetAPB1Prescaler(LL_RCC_APB1_DIV_1);
-  LL_RCC_SetAPB2Prescaler(LL_RCC_APB2_DIV_1);
-  LL_RCC_SetSysClkSource(LL_RCC_SYS_CLKSOURCE_PLL);
-
-   /* Wait till System clock is ready */
-  while(LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_PLL)
-  {
-
-  }
-
-  LL_Init1msTick(32000000);
-
-  LL_SetSystemCoreClock(32000000);
-}
-
-/**
-  * @brief GPIO Initialization Function
-  * @param None
-  * @retval None
-  */
-static void MX_GPIO_Init(void)
-{
-  LL_EXTI_InitTypeDef EXTI_InitStruct = {0};
-  LL_GPIO_InitTypeDef GPIO_InitStruct = {0};
-
-  /* GPIO Ports Clock Enable */
-  LL_IOP_GRP1_EnableClock(LL_IOP_GRP1_PERIPH_GPIOB);
-  LL_IOP_GRP1_EnableClock(LL_IOP_GRP1_PERIPH_GPIOC);
-  LL_IOP_GRP1_EnableClock(LL_IOP_GRP1_PERIPH_GPIOA);
-
-  /**/
-  LL_GPIO_ResetOutputPin(HOME_GPIO_Port, HOME_Pin);
-
-  /**/
-  LL_GPIO_ResetOutputPin(S_STEP_GPIO_Port, S_STEP_Pin);
-
-  /**/
-  LL_GPIO_ResetOutputPin(S_DIR_GPIO_Port, S_DIR_Pin);
-
-  /**/
-  LL_GPIO_ResetOutputPin(S_NEN_GPIO_Port, S_NEN_Pin);
-
-  /**/
-  LL_GPIO_ResetOutputPin(S_M0_GPIO_Port, S_M0_Pin);
-
-  /**/
-  LL_GPIO_ResetOutputPin(S_M1_GPIO_Port, S_M1_Pin);
-
-  /**/
-  LL_GPIO_ResetOutputPin(S_M2_GPIO_Port, S_M2_Pin);
-
-  /**/
-  LL_GPIO_ResetOutputPin(S_NRST_GPIO_Port, S_NRST_Pin);
-
-  /**/
-  
-  // #define LIMIT_Pin LL_GPIO_PIN_9
-  // #define LIMIT_GPIO_Port GPIOB  
-  // #define S_NFLT_Pin LL_GPIO_PIN_0
-  // #define S_NFLT_GPIO_Port GPIOA
-  LL_SYSCFG_SetEXTISource(LL_SYSCFG_EXTI_PORTB, LL_SYSCFG_EXTI_LINE9);
-  LL_SYSCFG_SetEXTISource(LL_SYSCFG_EXTI_PORTA, LL_SYSCFG_EXTI_LINE0);
-
-  LL_GPIO_SetPinPull(GPIOB, LL_GPIO_PIN_9, LL_GPIO_PULL_UP);
-  LL_GPIO_SetPinPull(GPIOA, LL_GPIO_PIN_0, LL_GPIO_PULL_UP);
-
-  LL_GPIO_SetPinMode(GPIOB, LL_GPIO_PIN_9, LL_GPIO_MODE_INPUT);
-  LL_GPIO_SetPinMode(GPIOA, LL_GPIO_PIN_0, LL_GPIO_MODE_INPUT);
-
-  /**/
-  EXTI_InitStruct.Line_0_31 = LL_EXTI_LINE_9;
-  EXTI_InitStruct.LineCommand = ENABLE;
-  EXTI_InitStruct.Mode = LL_EXTI_MODE_IT;
-  EXTI_InitStruct.Trigger = LL_EXTI_TRIGGER_RISING;
-  LL_EXTI_Init(&EXTI_InitStruct);
-
-  /**/
-  EXTI_InitStruct.Line_0_31 = LL_EXTI_LINE_0;
-  EXTI_InitStruct.LineCommand = ENABLE;
-  EXTI_InitStruct.Mode = LL_EXTI_MODE_IT;
-  EXTI_InitStruct.Trigger = LL_EXTI_TRIGGER_RISING;
-  LL_EXTI_Init(&EXTI_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = SW0_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_INPUT;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
-  LL_GPIO_Init(SW0_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = SW1_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_INPUT;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
-  LL_GPIO_Init(SW1_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = HOME_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(HOME_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = S_STEP_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(S_STEP_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = S_DIR_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(S_DIR_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = S_NEN_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(S_NEN_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = S_M0_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(S_M0_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = S_M1_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(S_M1_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = S_M2_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(S_M2_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = EN_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_INPUT;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(EN_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = S_NRST_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(S_NRST_GPIO_Port, &GPIO_InitStruct);
-
-  /**/
-  GPIO_InitStruct.Pin = DIR_Pin;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_INPUT;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
-  LL_GPIO_Init(DIR_GPIO_Port, &GPIO_InitStruct);
-
-}
-
-/* USER CODE BEGIN 4 */
-
-/* USER CODE END 4 */
-
-/**
-  * @brief  This function is executed in case of error occurrence.
-  * @retval None
-  */
-void Error_Handler(void)
-{
-  /* USER CODE BEGIN Error_Handler_Debug */
-  /* User can add his own implementation to report the HAL error return state */
-
-  /* USER CODE END Error_Handler_Debug */
-}
-
-#ifdef  USE_FULL_ASSERT
-/**
-  * @brief  Reports the name of the source file and the source line number
-  *         where the assert_param error has occurred.
-  * @param  file: pointer to the source file name
-  * @param  line: assert_param error line source number
-  * @retval None
-  */
-void assert_failed(uint8_t *file, uint32_t line)
-{
-  /* USER CODE BEGIN 6 */
-  /* User can add his own implementation to report the file name and line number,
-     tex: printf("Wrong parameters value: file %s on line %d\r\n", file, line) */
-  /* USER CODE END 6 */
-}
-#endif /* USE_FULL_ASSERT */
-
-/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// main.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "stepper.h"
+#include "eeprom.h"
+#include "timebase.h"
+#include "tuning.h"
+#include "trace.h"
+#include "profile.h"
+#include "input.h"
+#include "priority.h"
+
+
+void SystemClock_Config(void);
+static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
+static void MX_TIM2_Init(void);
+static void MX_TIM21_Init(void);
+static void MX_CRC_Init(void);
+static void MX_LPTIM1_Init(void);
+#ifdef TUNING_UART
+static void MX_LPUART1_Init(void);
+#endif
+#ifdef TRACE_UART
+static void MX_USART2_Init(void);
+#endif
+
+#define HAL_GetTick()                       (systick)
+#define SECONDS_TO_TICKS(s)                 ((s)*1000)
+#define MINUTES_TO_TICKS(s)                 (SECONDS_TO_TICKS(s)*60)
+
+// the interrupt priorities, and what each handler costs against its deadline, are in
+// priority.h
+
+#define STEP_SIZE                           500
+#define STEP_PERIOD                         US_TO_STEP_TICKS(STEP_SIZE*2)
+
+// level moves, the old microstep ramp averaged ~5000 steps/s/s up to 1000 steps/s
+#define STEP_START                          100
+#define STEP_SPEED                          1200
+#define STEP_ACCEL                          8000
+
+
+
+// boot homing, run down onto the limit fast, back off and come back onto it at the old
+// 1/8 step STEP_PERIOD pace. stopping from the seek speed overruns the switch by
+// HOMING_SEEK_SPEED^2/(2*STEP_ACCEL) ~ 23 steps so the back off has to clear that
+#define HOMING_SEEK_SPEED                   600
+#define HOMING_SEEK_USTEPS                  (3 * USTEPS_PER_LEVEL)
+#define HOMING_BACKOFF_STEPS                50
+#define LIMIT_LOCKOUT_US                    20000
+
+// a limit crossing further than this from where it should be isn't lost steps. the EXTI
+// reads it up to its response time in host/sched.c late, ~13000 cycles, at the default
+// 38400 pulses/s that's 16 usteps of correction error
+#define DRIFT_MAX_USTEPS                    (4 * USTEPS_PER_STEP)
+// when down sits at or above the switch, moves down don't cross it on their own. after this
+// many without a crossing the next one runs on past the switch to check the count
+#define DRIFT_CHECK_MOVES                   64
+
+// how long to sit still before the position is worth saving for a warm reset. a game
+// keeps the elevator going with short pauses, each save costs a clear before the next move,
+// so only once it's been left about as long as it takes the driver to be let go
+#define POSITION_SAVE_MS                    HOLD_RELEASE_MS
+// and after the last fine adjustment press before it's written
+#define PRESS_COMMIT_MS                     3000
+
+// the lead screw holds the carriage without power, so after sitting still this long the
+// driver is let go. on the drv8825 nENBL only turns the bridges off, the indexer keeps its
+// microstep so the coils come back on in the phase they left and nothing is lost, as long
+// as nothing steps while it's off. the current needs a moment to build before stepping
+#define HOLD_RELEASE_MS                     MINUTES_TO_TICKS(1)
+#define ENERGISE_US                         1000
+
+// an nFAULT is recovered by pulsing nRESET, which also puts the indexer back to its home
+// microstep, so the position is found again on the limit switch. each fault halves level
+// move speed and acceleration, up to FAULT_DERATE_MAX times, and each FAULT_CLEAN_MOVES
+// moves without one win a halving back. a driver still faulted after its reset is tried
+// FAULT_RETRIES times before it's left off until power is cycled
+#define FAULT_RESET_US                      20
+#define FAULT_WAKE_US                       1000
+#define FAULT_RETRIES                       3
+#define FAULT_DERATE_MAX                    2
+#define FAULT_CLEAN_MOVES                   32
+#define FAULT_LOG_LEN                       4
+
+// stall a bit for the williams cpu to see that we completed the move
+// allowing it to properly decide to disable or enable the dc motor enable signal
+#define MOTION_SETTLE_MS                    10
+
+typedef enum {
+    motion_idle = 0,
+    motion_moving = 1,
+    motion_settling = 2,
+    motion_reversing = 3,
+    motion_turning = 4     // stopped short, for the loop to start back the other way
+} motion_t;
+
+static volatile motion_t motion = motion_idle;
+static volatile uint32_t motion_timer = 0;
+
+static volatile uint32_t systick = 0;
+// called from stm32l0xx_it.c weak link ISR
+void mySysTick_Handler(void) {
+  systick++;
+  inputSample();
+  if ( motion == motion_settling && systick - motion_timer >= MOTION_SETTLE_MS ) {
+    motion = motion_idle;
+  }
+}
+
+volatile bool fault = false;
+#ifdef DEBUG
+static void faultLog(void);
+#endif
+
+void myIRQ_0_1(void) {
+  // #define S_NFLT_Pin LL_GPIO_PIN_0
+  // #define S_NFLT_GPIO_Port GPIOA
+  // #define S_NFLT_EXTI_IRQn EXTI0_1_IRQn
+  if ( fault ) {
+    return;
+  }
+  // the bridges are off, pulses from here would only run the count away from the carriage,
+  // so none go out until recover() has the driver back
+  stepperHalt();
+  fault = true;
+#ifdef DEBUG
+  faultLog();
+#endif
+  TRACE( trace_fault, 0 );
+}
+
+typedef enum {
+    homing_off = 0,
+    homing_seek = 1,
+    homing_approach = 2
+} homing_t;
+
+static volatile homing_t homing = homing_off;
+
+#ifdef DEBUG
+// reset to HOME first showing something the wpc89 can trust, for the debugger
+volatile uint32_t boot_home_us = 0;
+#endif
+
+static void limitEdge(void);
+
+// called from input.c in the SysTick once the limit switch has settled either way. the
+// EXTI below acted on the first edge long before, this is only the level for the trace
+void myInputLimit(bool hit) {
+  TRACE( trace_limit_level, hit );
+}
+
+void myIRQ_4_15(void) {  
+  // #define LIMIT_Pin LL_GPIO_PIN_9
+  // #define LIMIT_GPIO_Port GPIOB
+  // #define LIMIT_EXTI_IRQn EXTI4_15_IRQn
+  //fault = true;
+
+  // the first edge is the contact, whatever the switch does for a while after is bounce.
+  // still reading hit once we get here rules out a glitch
+  static uint32_t limit_at = 0 - LIMIT_LOCKOUT_US;
+  uint32_t now = micros();
+  if ( !LL_GPIO_IsInputPinSet( LIMIT_GPIO_Port, LIMIT_Pin ) || now - limit_at < LIMIT_LOCKOUT_US ) {
+    return;
+  }
+  limit_at = now;
+  TRACE( trace_limit, TRACE_ZIGZAG( stepperPosition() ) );
+  if ( homing == homing_seek ) {
+    // too quick to stop dead, ramp down past the switch
+    stepperDecelerate();
+  } else if ( homing == homing_approach ) {
+    stepperStop();
+  } else {
+    limitEdge();
+  }
+}
+
+
+typedef enum {
+    step_enable = 0,
+    step_disable = 1
+} step_enabled_t;
+
+typedef enum {
+    step_assert = 0,
+    step_deassert = 1
+} step_reset_t;
+
+typedef enum {
+    motor_dir_cw = 1,
+    motor_dir_ccw = 0
+} motor_dir_t;
+
+typedef enum {
+    motor_enable = 0,
+    motor_disable = 1
+} motor_enable_t;
+
+typedef enum {
+    opto_open = 1,
+    opto_closed = 0
+} opto_t;
+
+// note: wpc89 is only 6809 @2MHz, 2 instructions per 1us
+// so a change on EN or DIR only counts once both have sat still this long
+#define WPC_SETTLE_US                       10
+#define WPC_QUEUE_LEN                       8
+
+typedef struct {
+    uint32_t at;            // us, from micros()
+    motor_enable_t enable;
+    motor_dir_t direction;
+} wpc_t;
+
+// edges on EN and DIR as the EXTI saw them
+static wpc_t wpc_queue[WPC_QUEUE_LEN];
+static volatile uint8_t wpc_head = 0;
+static volatile uint8_t wpc_tail = 0;
+static uint32_t wpc_edge_at = 0;
+static bool wpc_pending = false;
+// what the wpc89 is settled on asking for
+static wpc_t wpc = { 0, motor_disable, motor_dir_cw };
+
+// sysclock cycles since boot, the systick count plus how far the SysTick counter is into
+// the ms. wraps every ~134s at 32MHz so only differences mean anything
+uint32_t cycles(void) {
+  uint32_t ms, val;
+  do {
+    ms = systick;
+    val = SysTick->VAL;
+  } while ( ms != systick );
+  if ( (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > SysTick->LOAD/2 ) {
+    // just reloaded, the handler is waiting on us
+    ms++;
+  }
+  return ms*(SysTick->LOAD+1) + (SysTick->LOAD - val);
+}
+
+static void wpcRead(wpc_t *w) {
+  w->enable = HAL_GPIO_ReadPin( EN_GPIO_Port, EN_Pin );
+  w->direction = HAL_GPIO_ReadPin( DIR_GPIO_Port, DIR_Pin );
+}
+
+// called from stm32l0xx_it.c on either edge of EN or DIR
+void myIRQ_EN_DIR(void) {
+  uint8_t head = wpc_head;
+  uint8_t next = (head + 1) % WPC_QUEUE_LEN;
+  if ( next == wpc_tail ) {
+    // full, only the newest edge matters so write over it
+    next = head;
+    head = (head + WPC_QUEUE_LEN - 1) % WPC_QUEUE_LEN;
+  }
+  wpc_queue[ head ].at = micros();
+  wpcRead( &wpc_queue[ head ] );
+  wpc_head = next;
+  TRACE( trace_en_dir, wpc_queue[ head ].enable << 1 | wpc_queue[ head ].direction );
+}
+
+// drain the edges and take the lines once they've settled, true when that's a new command
+static bool wpcCommand(void) {
+  while ( wpc_tail != wpc_head ) {
+    wpc_edge_at = wpc_queue[ wpc_tail ].at;
+    wpc_tail = (wpc_tail + 1) % WPC_QUEUE_LEN;
+    wpc_pending = true;
+  }
+  if ( !wpc_pending || micros() - wpc_edge_at < WPC_SETTLE_US ) {
+    return false;
+  }
+  wpc_pending = false;
+  // nothing has moved for the whole window so the pins as they are now are the answer,
+  // a glitch that came and went leaves them where they were
+  wpc_t now;
+  wpcRead( &now );
+  now.at = wpc_edge_at;
+  if ( now.enable == wpc.enable && now.direction == wpc.direction ) {
+    return false;
+  }
+  wpc = now;
+  TRACE( trace_command, wpc.enable << 1 | wpc.direction );
+  return true;
+}
+
+#ifdef DEBUG
+// what the idle loop has been doing, for the debugger. wake to step is from coming out of
+// stop to the first pulse of the move that woke us, it includes WPC_SETTLE_US
+typedef struct {
+    uint32_t sleeps;
+    uint32_t stops;
+    uint32_t wake_to_step_us;
+    uint32_t worst_wake_to_step_us;
+} idle_stats_t;
+
+volatile idle_stats_t idle_stats = {0};
+static bool woke = false;
+static uint32_t woke_at = 0;
+
+// what the hold policy has been doing, for the debugger
+typedef struct {
+    uint32_t releases;
+    uint32_t energised_ms;      // total with the coils powered
+    uint32_t reenable_us;       // from asking for the driver to it being ready to step
+    uint32_t worst_reenable_us;
+} hold_stats_t;
+
+volatile hold_stats_t hold_stats = {0};
+static uint32_t energised_at = 0;
+#endif
+static bool energised = false;
+static uint32_t driver_at = 0;
+
+// how many times level moves are halved since a fault, and the clean moves towards one less
+static uint8_t derate = 0;
+static uint8_t clean_moves = 0;
+
+// power the coils for a move, only waits when they were off
+static void driverEnable(void) {
+  driver_at = systick;
+  if ( energised ) {
+    return;
+  }
+#ifdef DEBUG
+  uint32_t start = micros();
+#endif
+  HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_enable );
+  energised = true;
+  delayUs( ENERGISE_US );
+#ifdef DEBUG
+  energised_at = systick;
+  hold_stats.reenable_us = micros() - start;
+  if ( hold_stats.reenable_us > hold_stats.worst_reenable_us ) {
+    hold_stats.worst_reenable_us = hold_stats.reenable_us;
+  }
+#endif
+}
+
+static void driverRelease(void) {
+  HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_disable );
+  if ( energised ) {
+#ifdef DEBUG
+    hold_stats.energised_ms += systick - energised_at;
+    hold_stats.releases++;
+#endif
+    energised = false;
+  }
+}
+
+// let the driver go once it's been still long enough
+static void holdPolicy(void) {
+  if ( !energised ) {
+    return;
+  }
+  // not the loop's tick, a nudge since then has moved driver_at on
+  uint32_t tick = systick;
+#ifdef DEBUG
+  hold_stats.energised_ms += tick - energised_at;
+  energised_at = tick;
+#endif
+  if ( motion == motion_idle && !stepperBusy() && tick - driver_at >= HOLD_RELEASE_MS ) {
+    driverRelease();
+  }
+}
+
+// wait for an interrupt. with nothing timed left, stop the clocks and wait for an edge, the
+// systick and micros() just pause while stopped. nothing runs on them at that point
+static void idle(bool stop) {
+#if defined(TUNING_UART) || defined(TRACE_UART)
+  // the uarts and their dma need the clocks
+  stop = false;
+#endif
+  // held off from here so an edge that comes in before the WFI still ends it
+  __disable_irq();
+  if ( wpc_pending || wpc_tail != wpc_head ) {
+    // waiting out the settle time, that's too short to sleep through a systick
+    __enable_irq();
+    return;
+  }
+#ifdef DEBUG
+  woke = false;
+#endif
+  if ( !stop ) {
+    __WFI();
+#ifdef DEBUG
+    idle_stats.sleeps++;
+#endif
+    __enable_irq();
+    return;
+  }
+
+  // stop rather than standby, regulator in low power, vrefint off and not waited for on
+  // the way out, all in the one register
+  MODIFY_REG( PWR->CR, PWR_CR_PDDS | PWR_CR_LPSDSR | PWR_CR_ULP | PWR_CR_FWU,
+              LL_PWR_MODE_STOP | LL_PWR_REGU_LPMODES_LOW_POWER | PWR_CR_ULP | PWR_CR_FWU );
+  LL_LPM_EnableDeepSleep();
+  __WFI();
+  LL_LPM_EnableSleep();
+  // a WFI with the regulator left in low power would be low power sleep, not at 32MHz
+  LL_PWR_SetRegulModeLP( LL_PWR_REGU_LPMODES_MAIN );
+  // back on HSI16, so LPTIM1 is counting again but the PLL has to come back up
+  SystemClock_Config();
+  SysTick_Config( SystemCoreClock / 1000 );
+#ifdef DEBUG
+  woke_at = micros();
+  woke = true;
+  idle_stats.stops++;
+#endif
+  __enable_irq();
+}
+
+typedef enum {
+    level_down  = 0,
+    level_mid_r = 1,
+    level_up    = 2,
+    level_mid_l = 3,
+} level_t;
+
+static volatile level_t current_level = 0;
+static level_t from_level = 0;
+static level_t target_level = 0;
+static motor_dir_t cam_direction = motor_dir_cw;
+static bool resume_saved = false;
+static void resumeForget(void);
+
+// where the limit switch closes, in the same position count as the levels. only known
+// after homing, a resume learns it from the first crossing
+static int32_t limit_ref = 0;
+static bool limit_known = false;
+static uint8_t unchecked = 0;       // moves down since the switch was last crossed
+static bool overrun = false;        // this move down runs on past the switch and back
+
+#ifdef DEBUG
+// how far off the count was each time a move down went past the switch, for the debugger
+typedef struct {
+    uint32_t crossings;
+    uint32_t corrected;     // crossings that moved the count
+    uint32_t rejected;      // too far off to be lost steps
+    int32_t last;           // usteps, positive when the count was above the carriage
+    int32_t worst;
+    int32_t net;
+} drift_t;
+
+volatile drift_t drift = {0};
+#endif
+
+typedef enum {
+    cam_right = 0,      // the half of the cam turn through mid_r
+    cam_left = 1        // and through mid_l
+} cam_side_t;
+
+static cam_side_t cam_side = cam_right;
+static step_dir_t travel = step_dir_down;
+
+// note: the WPC diagnostics errors correspond to the level you're going to
+
+// where you're going, from where you are
+static const level_t transitions[2][4] = {
+  // CCW cam direction
+  [motor_dir_ccw] = {
+    [level_down]  = level_mid_r,
+    [level_mid_r] = level_up,
+    [level_up]    = level_mid_l,
+    [level_mid_l] = level_down,
+  },
+  // CW cam direction
+  [motor_dir_cw] = {
+    [level_down]  = level_mid_l,
+    [level_mid_l] = level_up,
+    [level_up]    = level_mid_r,
+    [level_mid_r] = level_down,
+  },
+};
+
+// cam angle, counted CCW from down, as a carriage position. the mid_l half runs back from 360
+#define CAM_DEGREES(d)                      ((int32_t)((d) * stepsPerCamDegree * USTEPS_PER_STEP + 0.5))
+
+// edges of the flag on the cam, taken halfway between where the old per move percentages
+// flipped turning CCW and CW (those were skewed to cover the latency of checking in the
+// step loop). between an edge and the next level in the direction of travel the opto reads
+// opposite to its at rest state, so every level move flips it once part way and once more
+// on arrival, whatever the speed profile. these and the level move profile are defaults,
+// the saved config takes over once it's been written
+static config_t config = {
+  .press_steps = 0,
+  .start = STEP_START,
+  .speed = STEP_SPEED,
+  .accel = STEP_ACCEL,
+  .cam_edges = {
+    [cam_right] = { CAM_DEGREES(3.15), CAM_DEGREES(176.85) },
+    [cam_left]  = { CAM_DEGREES(360-324.45), CAM_DEGREES(360-215.55) },
+  },
+};
+
+static const step_profile_t homing_profile = {
+  .start = STEP_START,
+  .speed = HOMING_SEEK_SPEED,
+  .accel = STEP_ACCEL,
+  .ramp = ramp_trapezoid
+};
+
+
+static void move(step_dir_t dir, int32_t usteps) {
+  // the whole move runs at 1/32 step, speed comes from the planner alone
+  stepSize( step_size_32nd );
+  driverEnable();
+  stepperDirection( dir );
+  delayUs(10);
+  
+  const step_profile_t level_profile = {
+    .start = config.start,
+    .speed = config.speed >> derate,
+    .accel = (config.accel >> derate) ? (config.accel >> derate) : 1,
+    .ramp = ramp_scurve
+  };
+  stepperMove( usteps, &level_profile );
+#ifdef DEBUG
+  if ( woke ) {
+    idle_stats.wake_to_step_us = micros() - woke_at;
+    if ( idle_stats.wake_to_step_us > idle_stats.worst_wake_to_step_us ) {
+      idle_stats.worst_wake_to_step_us = idle_stats.wake_to_step_us;
+    }
+    woke = false;
+  }
+#endif
+}
+
+// HOME is what the wpc89 takes for the cam opto
+static void homeSet(opto_t level) {
+  HAL_GPIO_WritePin( HOME_GPIO_Port, HOME_Pin, level );
+  TRACE( trace_home, level );
+}
+
+static void homeToggle(void) {
+  HAL_GPIO_TogglePin( HOME_GPIO_Port, HOME_Pin );
+  TRACE( trace_home, LL_GPIO_IsOutputPinSet( HOME_GPIO_Port, HOME_Pin ) );
+}
+
+// at rest the opto only depends on which way the cam last turned, every level move
+// flips it once part way and once more on arrival
+static opto_t optoAtRest(motor_dir_t direction) {
+  return ( direction == motor_dir_cw ) ? opto_open : opto_closed;
+}
+
+static int32_t levelPosition(level_t level) {
+  switch ( level ) {
+    case level_down:
+      return 0;
+    case level_up:
+      return 2 * USTEPS_PER_LEVEL;
+    default:
+      return USTEPS_PER_LEVEL;
+  }
+}
+
+// the level at or below a cam edge. edges are never negative, and dividing unsigned keeps
+// the m0+'s signed division routine out of the image
+static int32_t levelBelow(int32_t edge) {
+  return ((uint32_t)edge / USTEPS_PER_LEVEL) * USTEPS_PER_LEVEL;
+}
+
+// set HOME for where the carriage is and, with arm, put the next place it changes on the
+// compare. both come out of the same look at each edge
+static void optoTrack(bool arm) {
+  int32_t pos = stepperPosition();
+  bool flipped = false;
+  int32_t next = pos;
+  for (int i=0; i<2; i++) {
+    int32_t edge = config.cam_edges[ cam_side ][ i ];
+    int32_t below = levelBelow( edge );
+    int32_t above = below + USTEPS_PER_LEVEL;
+    if ( travel == step_dir_up ) {
+      flipped |= ( pos >= edge && pos < above );
+      int32_t at = ( edge > pos ) ? edge : above;
+      if ( at > pos && (next == pos || at < next) ) {
+        next = at;
+      }
+    } else {
+      flipped |= ( pos > below && pos <= edge );
+      int32_t at = ( edge < pos ) ? edge : below;
+      if ( at < pos && (next == pos || at > next) ) {
+        next = at;
+      }
+    }
+  }
+  homeSet( flipped ? !optoAtRest( cam_direction ) : optoAtRest( cam_direction ) );
+  if ( arm && next != pos ) {
+    stepperOptoAt( next );
+  } else {
+    stepperOptoOff();
+  }
+}
+
+// from myIRQ_4_15, the switch closed under us. only moves down to the bottom go past it
+// so those keep the count honest without ever re-homing
+static void limitEdge(void) {
+  if ( motion != motion_moving || travel != step_dir_down || target_level != level_down ) {
+    return;
+  }
+  int32_t at = stepperPosition();
+#ifdef DEBUG
+  drift.crossings++;
+#endif
+  if ( !limit_known ) {
+    limit_ref = at;
+    limit_known = true;
+    unchecked = 0;
+    return;
+  }
+  int32_t error = at - limit_ref;
+  if ( abs( error ) > DRIFT_MAX_USTEPS ) {
+#ifdef DEBUG
+    drift.rejected++;
+#endif
+    return;
+  }
+  unchecked = 0;
+  if ( error ) {
+    // what's left of the move is re-seeded with it, so it still ends on the level
+    stepperShift( -error );
+  }
+#ifdef DEBUG
+  drift.corrected += ( error != 0 );
+  drift.last = error;
+  drift.net += error;
+  if ( abs( error ) > drift.worst ) {
+    drift.worst = abs( error );
+  }
+#endif
+}
+
+// called from stepper.c in the step timer ISR when the carriage gets to the armed edge
+void myStepperOpto(void) {
+  if ( overrun && stepperPosition() <= levelPosition( level_down ) ) {
+    // running on past down, HOME keeps reading away until the carriage is back
+    stepperOptoOff();
+    return;
+  }
+  optoTrack( true );
+}
+
+static void arrive(void) {
+  current_level = target_level;
+  if ( derate && ++clean_moves >= FAULT_CLEAN_MOVES ) {
+    derate--;
+    clean_moves = 0;
+  }
+  // signal complete to the wpc89, the last edge already put the opto here
+  stepperOptoOff();
+  homeSet( optoAtRest( cam_direction ) );
+  motion_timer = systick;
+  motion = motion_settling;
+}
+
+// from wherever the carriage is now to target_level
+static void moveTo(void) {
+  cam_side = ( from_level == level_mid_r || target_level == level_mid_r ) ? cam_right : cam_left;
+  int32_t at = stepperPosition();
+  int32_t to = levelPosition( target_level );
+  bool back = overrun && target_level == level_down;
+  overrun = false;
+  if ( target_level == level_down && at > 0 && limit_ref < DRIFT_MAX_USTEPS ) {
+    // the fine adjustment has down too near the switch, or above it, to be sure of crossing
+    // it. once in a while, or to find it after a resume, run on past where it closes and
+    // come back up, myStepperDone hands that back here
+    if ( !limit_known || ++unchecked >= DRIFT_CHECK_MOVES ) {
+      to = limit_ref - DRIFT_MAX_USTEPS;
+      overrun = true;
+      unchecked = 0;
+    }
+  }
+  travel = ( to >= at ) ? step_dir_up : step_dir_down;
+
+  motion = motion_moving;
+  if ( to == at ) {
+    arrive();
+    return;
+  }
+  if ( back ) {
+    // coming back up onto down, HOME already reads away and arrive() sets it
+    stepperOptoOff();
+  } else {
+    optoTrack( true );
+  }
+  move( travel, abs( to - at ) );
+}
+
+// called from stepper.c in the step timer ISR when a run has finished
+void myStepperDone(void) {
+  if ( motion == motion_moving && stepperPosition() == levelPosition( target_level ) ) {
+    arrive();
+  } else if ( motion == motion_moving || motion == motion_reversing ) {
+    // stopped short, or run on past the switch, planning the way back is too long for here
+    // so the loop starts it
+    motion = motion_turning;
+  }
+}
+
+static void moveSteps( int steps, step_size_t sz ) {
+  stepperWait();
+  driverEnable();
+  step_dir_t direction = (steps>0) ? step_dir_up : step_dir_down;
+  int m = stepSize( sz );
+  stepperDirection( direction );
+  delayUs(10);
+
+  stepperStart( abs(steps)*m, STEP_PERIOD );
+  stepperWait();
+}
+
+static void moveLevel( motor_dir_t direction ) {
+  if ( motion == motion_settling ) {
+    return;
+  }
+  if ( motion != motion_idle ) {
+    // the wpc89 changed its mind part way, slow down and go back where we came from.
+    // the step timer may be finishing the move right now so decide with it held off
+    __disable_irq();
+    if ( motion != motion_settling && direction != cam_direction ) {
+      level_t level = from_level;
+      from_level = target_level;
+      target_level = level;
+      cam_direction = direction;
+      // read as if already heading back, edges passed while stopping are left out
+      travel = ( travel == step_dir_up ) ? step_dir_down : step_dir_up;
+      optoTrack( false );
+      if ( motion != motion_turning ) {
+        motion = motion_reversing;
+        stepperDecelerate();
+      }
+    }
+    __enable_irq();
+    return;
+  }
+
+  // the eeprom shares the bank we run from, let it finish before the step timer needs us.
+  // a few words at ~3ms each, waited out rather than dropped so a one shot button hold
+  // still gets its move. the resume clear is one word, and only the first move after the
+  // elevator has sat still for POSITION_SAVE_MS has one
+  resumeForget();
+  while ( eeBusy() );
+  if ( direction != cam_direction ) {
+    homeToggle();
+    cam_direction = direction;
+  }
+  from_level = current_level;
+  target_level = transitions[ direction ][ current_level ];
+  moveTo();
+}
+
+
+
+
+// find the limit switch and zero on it plus the user's fine adjustment
+static void home(int32_t pressSteps) {
+  // move off the switch
+  if ( inputActive( input_limit ) ) {
+    moveSteps( stepsPerRotation, step_size_4th );
+  }
+
+  // find the switch fast, further than the carriage can go so it always gets there. after a
+  // fault recover() has let the driver go, and unlike moveSteps() nothing here powers it
+  driverEnable();
+  stepSize( step_size_32nd );
+  stepperDirection( step_dir_down );
+  homing = homing_seek;
+  stepperMove( HOMING_SEEK_USTEPS, &homing_profile );
+  stepperWait();
+  homing = homing_off;
+
+  // then a little way off it and back on slowly, myIRQ_4_15 stops us on the first contact
+  moveSteps( HOMING_BACKOFF_STEPS, step_size_4th );
+  stepSize( step_size_8th );
+  stepperDirection( step_dir_down );
+  homing = homing_approach;
+  stepperStart( 2 * HOMING_BACKOFF_STEPS * 8, STEP_PERIOD );
+  stepperWait();
+  homing = homing_off;
+  int32_t contact = stepperPosition();
+
+  moveSteps( pressSteps, step_size_8th );
+  current_level = level_down;
+  cam_direction = motor_dir_cw;
+  limit_ref = contact - stepperPosition();
+  limit_known = true;
+  unchecked = 0;
+  stepperSetPosition( 0 );
+}
+
+static uint8_t fault_tries = 0;
+#ifdef DEBUG
+// the last few faults and how recovery went, for the debugger
+typedef struct {
+    uint32_t at;                // systick
+    motion_t motion;
+    homing_t homing;
+    level_t from;
+    level_t target;
+    int32_t position;
+} fault_record_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t recovered;
+    uint32_t abandoned;
+    uint32_t recovery_us;       // fault to homed and ready for the wpc89 again
+    uint32_t worst_recovery_us;
+    fault_record_t log[FAULT_LOG_LEN];
+} fault_stats_t;
+
+volatile fault_stats_t fault_stats = {0};
+static uint32_t fault_at = 0;
+// set from the debugger to run the recovery as if nFAULT had gone low
+volatile bool fault_inject = false;
+
+// called from myIRQ_0_1, what we were doing when it happened
+static void faultLog(void) {
+  fault_at = micros();
+  volatile fault_record_t *r = &fault_stats.log[ fault_stats.count % FAULT_LOG_LEN ];
+  r->at = systick;
+  r->motion = motion;
+  r->homing = homing;
+  r->from = from_level;
+  r->target = target_level;
+  r->position = stepperPosition();
+  fault_stats.count++;
+}
+#endif
+
+// reset the driver and find the carriage again, from the main loop
+static void recover(void) {
+  driverRelease();
+  if ( fault_tries > FAULT_RETRIES ) {
+    // given up, same as it always was, off until a power cycle
+    return;
+  }
+  motion = motion_idle;
+  homing = homing_off;
+  stepperOptoOff();
+  resumeForget();
+
+  HAL_GPIO_WritePin( S_NRST_GPIO_Port, S_NRST_Pin, step_assert );
+  delayUs( FAULT_RESET_US );
+  HAL_GPIO_WritePin( S_NRST_GPIO_Port, S_NRST_Pin, step_deassert );
+  stepperPhaseHome();
+  delayUs( FAULT_WAKE_US );
+  if ( ++fault_tries > FAULT_RETRIES ) {
+#ifdef DEBUG
+    fault_stats.abandoned++;
+#endif
+    return;
+  }
+  if ( HAL_GPIO_ReadPin( S_NFLT_GPIO_Port, S_NFLT_Pin ) == 0 ) {
+    // still latched, the next pass tries again
+    return;
+  }
+
+  if ( derate < FAULT_DERATE_MAX ) {
+    derate++;
+  }
+  clean_moves = 0;
+  fault = false;
+  stepperResume();
+  // forgetting the resume record queued a write, homing needs the flash bank back
+  while ( eeBusy() );
+  home( config.press_steps );
+  if ( fault ) {
+    // again while homing, start over
+    return;
+  }
+  homeSet( optoAtRest( cam_direction ) );
+  stepperDirection( step_dir_down );
+  motion_timer = systick;
+  fault_tries = 0;
+#ifdef DEBUG
+  fault_stats.recovered++;
+  fault_stats.recovery_us = micros() - fault_at;
+  if ( fault_stats.recovery_us > fault_stats.worst_recovery_us ) {
+    fault_stats.worst_recovery_us = fault_stats.recovery_us;
+  }
+#endif
+}
+
+// the fine adjustment buttons move where down is, so the levels go with it. moveSteps()
+// counts whole steps whatever the step size, the same as home() takes press_steps
+static void nudge(int steps) {
+  resumeForget();
+  while ( eeBusy() );
+  int32_t at = stepperPosition();
+  moveSteps( steps, step_size_4th );
+  stepperSetPosition( at );
+  limit_ref -= steps * USTEPS_PER_STEP;
+}
+
+// where we last sat still, enough to carry on after a reset without homing. the record
+// is cleared before anything moves, so a reset part way through a move or a save finds
+// nothing to resume. eeprom.c spreads the records round a ring for the wear. R5 holds the
+// drv8825 in reset while we are, which pulls the rotor round to the indexer's home entry,
+// so the position saved is the one it'll be at after that
+static void resumeSave(void) {
+  resumeWrite( (inputActive(input_limit) << 3) | (cam_direction << 2) | current_level, stepperPhaseHomeAt() );
+  resume_saved = true;
+}
+
+static void resumeForget(void) {
+  if ( resume_saved ) {
+    resumeClear();
+    resume_saved = false;
+  }
+}
+
+static bool resumeLoad(void) {
+  uint8_t mark;
+  int32_t at;
+  if ( !resumeRead( &mark, &at ) ) {
+    return false;
+  }
+  level_t level = mark & 0x03;
+  motor_dir_t direction = (mark >> 2) & 0x01;
+  // has to be sitting on a level, give or take drift still to be made up, and the switch
+  // has to read as it did when we saved, anything else and the carriage was moved while we were off
+  if ( abs( at - levelPosition( level ) ) > DRIFT_MAX_USTEPS || ((mark >> 3) & 0x01) != inputActive(input_limit) ) {
+    return false;
+  }
+  current_level = level;
+  cam_direction = direction;
+  stepperSetPosition( at );
+  resume_saved = true;
+  return true;
+}
+
+
+int main(void)
+{
+  LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_SYSCFG);
+  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_PWR);
+  SystemClock_Config();
+  SysTick_Config(SystemCoreClock / 1000);
+  MX_GPIO_Init();
+  MX_DMA_Init();
+  MX_TIM2_Init();
+  MX_TIM21_Init();
+  MX_CRC_Init();
+  MX_LPTIM1_Init();
+  inputStart();
+#ifdef DEBUG
+  // keep the debugger connected through sleep and stop
+  LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_DBGMCU);
+  LL_DBGMCU_EnableDBGSleepMode();
+  LL_DBGMCU_EnableDBGStopMode();
+#endif
+  timebaseStart();
+#ifdef TUNING_UART
+  MX_LPUART1_Init();
+  tuningStart();
+#endif
+#ifdef TRACE_UART
+  MX_USART2_Init();
+  traceStart();
+#endif
+  
+  NVIC_SetPriority(LIMIT_EXTI_IRQn, PRIORITY_EDGE);
+  NVIC_EnableIRQ(LIMIT_EXTI_IRQn);
+  NVIC_SetPriority(S_NFLT_EXTI_IRQn, PRIORITY_EDGE);
+  NVIC_EnableIRQ(S_NFLT_EXTI_IRQn);
+  
+  NVIC_SetPriority(FLASH_IRQn, PRIORITY_BACKGROUND);
+  NVIC_EnableIRQ(FLASH_IRQn);
+  
+  HAL_GPIO_WritePin( S_NRST_GPIO_Port, S_NRST_Pin, step_deassert );
+  stepperPhaseHome();
+  driverEnable();
+
+  // the user's fine adjustment and tuning stored from non-voltaile, from before there
+  // were config records it was the first word on its own
+  if ( !configLoad( &config ) ) {
+    eeRead( EE_PRESS_STEPS, &config.press_steps );
+  }
+  // // blink the press step adjustment count on the led
+  // HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_disable );
+  // delayMs(500);
+  // for (int i=0; i<config.press_steps; i++) {
+  //   HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_enable );
+  //   delayMs(10);
+  //   HAL_GPIO_WritePin( S_NEN_GPIO_Port, S_NEN_Pin, step_disable );
+  //   delayMs(100);
+  // }
+
+  // a reset that came while we were sitting still can pick up from there
+  if ( !resumeLoad() ) {
+    home( config.press_steps );
+  }
+
+  // once we zero the stepper, we can allow the machine to "home the cam"
+  // machine will try to home the to cam CW down, where opto is open at complete
+  // just to the right of the little nub on the cam
+  homeSet( optoAtRest( cam_direction ) );
+#ifdef DEBUG
+  boot_home_us = micros();
+#endif
+  stepperDirection( step_dir_down );
+  
+  fault = false;
+
+  // from here on EN and DIR come in through the EXTI, edges while homing don't count
+  wpc_tail = wpc_head;
+  wpcRead( &wpc );
+  NVIC_EnableIRQ(EN_EXTI_IRQn);
+  NVIC_EnableIRQ(DIR_EXTI_IRQn);
+  
+#ifdef PROFILE
+  profileStart();
+#endif
+
+  while (1) {
+    PROFILE_LAP( prof_loop );
+    
+    uint32_t tick = HAL_GetTick();
+    static uint32_t press_at = 0;
+    static bool commit = false;
+    static bool saving = false;
+
+#ifdef DEBUG
+    if ( fault_inject ) {
+      fault_inject = false;
+      myIRQ_0_1();
+    }
+#endif
+    if ( fault ) {
+      recover();
+      continue;
+    }
+
+    // enable is a level, the dc motor this replaces keeps turning while it's held
+    PROFILE_BEGIN( prof_wpc );
+    wpcCommand();
+    PROFILE_END( prof_wpc );
+    if ( wpc.enable == motor_enable ) {
+        moveLevel( wpc.direction );
+    }
+    if ( motion == motion_turning ) {
+      moveTo();
+    }
+
+    // moves run from the step timer, the loop only starts or reverses them
+    if ( motion != motion_idle ) {
+      idle( false );
+      continue;
+    }
+
+#ifdef TUNING_UART
+    // frames wait in the dma ring while we move. a new fine adjustment goes in straight
+    // away the same as the buttons would put it, anything else waits for the next move
+    int32_t pressed = config.press_steps;
+    if ( tuningPoll( &config ) ) {
+      commit = true;
+    }
+    if ( config.press_steps != pressed ) {
+      nudge( config.press_steps - pressed );
+    }
+#endif
+
+    if ( !resume_saved && tick - motion_timer >= POSITION_SAVE_MS ) {
+      resumeSave();
+    }
+
+    // a run of adjustments goes to the eeprom once, after the presses stop
+    if ( commit || (press_at && tick - press_at >= PRESS_COMMIT_MS) ) {
+      configSave( &config );
+      press_at = 0;
+      commit = false;
+      saving = true;
+    }
+    // done once the last word is in or failed, a failed save goes round again to the next slot
+    if ( saving && !eeBusy() ) {
+      saving = false;
+      bool ok = !eeError();
+      if ( !ok ) {
+        press_at = tick;
+      }
+#ifdef TUNING_UART
+      tuningSaved( ok );
+#endif
+    }
+    
+    // the buttons queue up while we're moving, one at a time once we're not. a tap nudges
+    // the down position, a hold runs a whole level without waiting for the release, we're
+    // idle here so that always starts
+    PROFILE_BEGIN( prof_buttons );
+    input_id_t id;
+    input_event_t event;
+    if ( inputNext( &id, &event ) ) {
+      int way = ( id == input_right ) ? 1 : -1;
+      if ( event == input_long ) {
+        moveLevel( ( id == input_right ) ? motor_dir_cw : motor_dir_ccw );
+      } else if ( event == input_short ) {
+        nudge( way );
+        config.press_steps += way;
+        press_at = tick;
+      }
+    }
+    PROFILE_END( prof_buttons );
+
+    holdPolicy();
+
+    // nothing left that needs the clock to keep time
+    bool quiet = !energised && resume_saved && !press_at && !commit && !saving && !eeBusy() && !fault &&
+                 wpc.enable != motor_enable && motion == motion_idle && inputQuiet();
+    idle( quiet );
+          
+  }
+
+}
+
+
+
+
+/**
+  * @brief System Clock Configuration
+  * @retval None
+  */
+void SystemClock_Config(void)
+{
+  LL_FLASH_SetLatency(LL_FLASH_LATENCY_1);
+  while(LL_FLASH_GetLatency()!= LL_FLASH_LATENCY_1)
+  {
+  }
+  LL_PWR_SetRegulVoltageScaling(LL_PWR_REGU_VOLTAGE_SCALE1);
+  LL_RCC_HSI_Enable();
+
+   /* Wait till HSI is ready */
+  while(LL_RCC_HSI_IsReady() != 1)
+  {
+
+  }
+  // the trimming, 16, and the bus prescalers, all undivided, are already how they come out
+  // of reset
+  LL_RCC_SetClkAfterWakeFromStop(LL_RCC_STOP_WAKEUPCLOCK_HSI);
+  LL_RCC_PLL_ConfigDomain_SYS(LL_RCC_PLLSOURCE_HSI, LL_RCC_PLL_MUL_4, LL_RCC_PLL_DIV_2);
+  LL_RCC_PLL_Enable();
+
+   /* Wait till PLL is ready */
+  while(LL_RCC_PLL_IsReady() != 1)
+  {
+
+  }
+  LL_RCC_SetSysClkSource(LL_RCC_SYS_CLKSOURCE_PLL);
+
+   /* Wait till System clock is ready */
+  while(LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_PLL)
+  {
+
+  }
+
+  // main() sets the 1ms SysTick up itself with its priority
+  LL_SetSystemCoreClock(32000000);
+}
+
+/**
+  * @brief GPIO Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_GPIO_Init(void)
+{
+  LL_GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  /* GPIO Ports Clock Enable */
+  LL_IOP_GRP1_EnableClock(LL_IOP_GRP1_PERIPH_GPIOB);
+  LL_IOP_GRP1_EnableClock(LL_IOP_GRP1_PERIPH_GPIOC);
+  LL_IOP_GRP1_EnableClock(LL_IOP_GRP1_PERIPH_GPIOA);
+
+  /**/
+  LL_GPIO_ResetOutputPin(HOME_GPIO_Port, HOME_Pin | S_DIR_Pin | S_NEN_Pin | S_M0_Pin | S_M1_Pin | S_M2_Pin | S_NRST_Pin);
+
+  /**/
+  
+  // #define LIMIT_Pin LL_GPIO_PIN_9
+  // #define LIMIT_GPIO_Port GPIOB  
+  // #define S_NFLT_Pin LL_GPIO_PIN_0
+  // #define S_NFLT_GPIO_Port GPIOA
+  // every line starts on port A, so only the others are set and each register is written
+  // whole rather than a line at a time. PA0 nFAULT and PA10 EN stay as they are
+  SYSCFG->EXTICR[0] = SYSCFG_EXTICR1_EXTI1_PB;
+  SYSCFG->EXTICR[2] = SYSCFG_EXTICR3_EXTI9_PB;
+  SYSCFG->EXTICR[3] = SYSCFG_EXTICR4_EXTI14_PC | SYSCFG_EXTICR4_EXTI15_PC;
+
+  // pins that share a port and a setup go through LL_GPIO_Init() together, the pulled up
+  // inputs on the other two ports reuse it with only the pin changed
+  /**/
+  GPIO_InitStruct.Pin = SW0_Pin | SW1_Pin;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_INPUT;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
+  LL_GPIO_Init(SW0_GPIO_Port, &GPIO_InitStruct);
+
+  GPIO_InitStruct.Pin = LIMIT_Pin;
+  LL_GPIO_Init(LIMIT_GPIO_Port, &GPIO_InitStruct);
+
+  GPIO_InitStruct.Pin = S_NFLT_Pin;
+  LL_GPIO_Init(S_NFLT_GPIO_Port, &GPIO_InitStruct);
+
+  /**/
+  GPIO_InitStruct.Pin = HOME_Pin | S_DIR_Pin | S_NEN_Pin | S_M0_Pin | S_M1_Pin | S_M2_Pin | S_NRST_Pin;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
+  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
+  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
+  LL_GPIO_Init(HOME_GPIO_Port, &GPIO_InitStruct);
+
+  /**/
+  GPIO_InitStruct.Pin = EN_Pin;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_INPUT;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
+  LL_GPIO_Init(EN_GPIO_Port, &GPIO_InitStruct);
+
+  /**/
+  GPIO_InitStruct.Pin = DIR_Pin;
+  LL_GPIO_Init(DIR_GPIO_Port, &GPIO_InitStruct);
+
+  // once the pins read what they will, so none of them setting up looks like an edge.
+  // LL_EXTI_Init() a line at a time costs more than the three registers it ends up in.
+  // LIMIT closes rising, nFAULT is open drain and pulls low on a fault, EN and DIR take
+  // both edges and the buttons only interrupt to wake us from stop, the SysTick samples them
+  LL_EXTI_EnableIT_0_31(LL_EXTI_LINE_9 | LL_EXTI_LINE_0 | LL_EXTI_LINE_10 | LL_EXTI_LINE_1 |
+                        LL_EXTI_LINE_14 | LL_EXTI_LINE_15);
+  LL_EXTI_EnableRisingTrig_0_31(LL_EXTI_LINE_9 | LL_EXTI_LINE_10 | LL_EXTI_LINE_1);
+  LL_EXTI_EnableFallingTrig_0_31(LL_EXTI_LINE_0 | LL_EXTI_LINE_10 | LL_EXTI_LINE_1 |
+                                 LL_EXTI_LINE_14 | LL_EXTI_LINE_15);
+
+}
+
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+
+  /* DMA interrupt init */
+  /* DMA1_Channel2_3_IRQn interrupt configuration */
+  NVIC_SetPriority(DMA1_Channel2_3_IRQn, PRIORITY_STEP);
+  NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+
+}
+
+/**
+  * @brief LPTIM1 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_LPTIM1_Init(void)
+{
+  LL_RCC_SetLPTIMClockSource(LL_RCC_LPTIM1_CLKSOURCE_HSI);
+
+  /* Peripheral clock enable */
+  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_LPTIM1);
+
+  /* LPTIM1 interrupt Init */
+  NVIC_SetPriority(LPTIM1_IRQn, PRIORITY_EDGE);
+  NVIC_EnableIRQ(LPTIM1_IRQn);
+
+  // internal clock, software trigger and immediate update are all how it comes out of reset
+  LL_LPTIM_SetPrescaler(LPTIM1, LL_LPTIM_PRESCALER_DIV16);
+}
+
+/**
+  * @brief TIM2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM2_Init(void)
+{
+  LL_GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  /* Peripheral clock enable */
+  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM2);
+
+  /* TIM2 DMA Init */
+
+  /* TIM2_UP Init */
+  LL_DMA_SetPeriphRequest(DMA1, LL_DMA_CHANNEL_2, LL_DMA_REQUEST_8);
+  LL_DMA_ConfigTransfer(DMA1, LL_DMA_CHANNEL_2, LL_DMA_DIRECTION_MEMORY_TO_PERIPH |
+                        LL_DMA_PRIORITY_VERYHIGH | LL_DMA_MODE_CIRCULAR |
+                        LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                        LL_DMA_PDATAALIGN_WORD | LL_DMA_MDATAALIGN_HALFWORD);
+  LL_DMA_EnableIT_HT(DMA1, LL_DMA_CHANNEL_2);
+  LL_DMA_EnableIT_TC(DMA1, LL_DMA_CHANNEL_2);
+
+  /* TIM2 interrupt Init */
+  NVIC_SetPriority(TIM2_IRQn, PRIORITY_STEP);
+  NVIC_EnableIRQ(TIM2_IRQn);
+
+  // counting up undivided is the reset state, every run loads the prescaler with its own
+  // update event before the counter starts
+  LL_TIM_SetPrescaler(TIM2, __LL_TIM_CALC_PSC(32000000, STEP_TIMER_HZ));
+  LL_TIM_EnableARRPreload(TIM2);
+  LL_TIM_SetUpdateSource(TIM2, LL_TIM_UPDATESOURCE_COUNTER);
+  LL_TIM_OC_EnablePreload(TIM2, LL_TIM_CHANNEL_CH3);
+  // LL_TIM_OC_Init() would pull in all four channels' setup for the one, the compare and
+  // polarity are already 0 and active high out of reset
+  LL_TIM_OC_SetMode(TIM2, LL_TIM_CHANNEL_CH3, LL_TIM_OCMODE_PWM1);
+  LL_TIM_CC_EnableChannel(TIM2, LL_TIM_CHANNEL_CH3);
+  LL_TIM_SetTriggerOutput(TIM2, LL_TIM_TRGO_OC3REF);
+
+  /**TIM2 GPIO Configuration
+  PA2   ------> TIM2_CH3
+  */
+  GPIO_InitStruct.Pin = S_STEP_Pin;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_ALTERNATE;
+  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
+  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
+  GPIO_InitStruct.Alternate = LL_GPIO_AF_2;
+  LL_GPIO_Init(S_STEP_GPIO_Port, &GPIO_InitStruct);
+}
+
+/**
+  * @brief TIM21 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM21_Init(void)
+{
+  /* Peripheral clock enable */
+  LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_TIM21);
+
+  /* TIM21 interrupt Init */
+  NVIC_SetPriority(TIM21_IRQn, PRIORITY_COUNT);
+  NVIC_EnableIRQ(TIM21_IRQn);
+
+  // out of reset it already counts up to 0xFFFF undivided with the trigger input on ITR0,
+  // TIM2's TRGO, and CH1 and CH2 frozen with their outputs off, only their compare
+  // interrupts are used
+  LL_TIM_SetUpdateSource(TIM21, LL_TIM_UPDATESOURCE_COUNTER);
+  LL_TIM_SetClockSource(TIM21, LL_TIM_CLOCKSOURCE_EXT_MODE1);
+  LL_TIM_ClearFlag_UPDATE(TIM21);
+  LL_TIM_EnableIT_UPDATE(TIM21);
+  LL_TIM_EnableCounter(TIM21);
+}
+
+/**
+  * @brief CRC Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_CRC_Init(void)
+{
+  /* Peripheral clock enable */
+  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_CRC);
+
+  // the reset state is already the plain crc32 the config records use, polynomial, size,
+  // initial value and no reversing
+}
+
+#ifdef TUNING_UART
+/**
+  * @brief LPUART1 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_LPUART1_Init(void)
+{
+  LL_LPUART_InitTypeDef LPUART_InitStruct = {0};
+  LL_GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  LL_RCC_SetLPUARTClockSource(LL_RCC_LPUART1_CLKSOURCE_PCLK1);
+
+  /* Peripheral clock enable */
+  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_LPUART1);
+
+  /**LPUART1 GPIO Configuration
+  PA13   ------> LPUART1_RX
+  PA14   ------> LPUART1_TX
+  */
+  GPIO_InitStruct.Pin = LL_GPIO_PIN_13|LL_GPIO_PIN_14;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_ALTERNATE;
+  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_VERY_HIGH;
+  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
+  GPIO_InitStruct.Alternate = LL_GPIO_AF_6;
+  LL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  /* LPUART1 DMA Init */
+
+  /* LPUART1_RX Init */
+  LL_DMA_SetPeriphRequest(DMA1, LL_DMA_CHANNEL_3, LL_DMA_REQUEST_5);
+  LL_DMA_SetDataTransferDirection(DMA1, LL_DMA_CHANNEL_3, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  LL_DMA_SetChannelPriorityLevel(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PRIORITY_LOW);
+  LL_DMA_SetMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MODE_CIRCULAR);
+  LL_DMA_SetPeriphIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PERIPH_NOINCREMENT);
+  LL_DMA_SetMemoryIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MEMORY_INCREMENT);
+  LL_DMA_SetPeriphSize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PDATAALIGN_BYTE);
+  LL_DMA_SetMemorySize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MDATAALIGN_BYTE);
+
+  LPUART_InitStruct.BaudRate = 115200;
+  LPUART_InitStruct.DataWidth = LL_LPUART_DATAWIDTH_8B;
+  LPUART_InitStruct.StopBits = LL_LPUART_STOPBITS_1;
+  LPUART_InitStruct.Parity = LL_LPUART_PARITY_NONE;
+  LPUART_InitStruct.TransferDirection = LL_LPUART_DIRECTION_TX_RX;
+  LPUART_InitStruct.HardwareFlowControl = LL_LPUART_HWCONTROL_NONE;
+  LL_LPUART_Init(LPUART1, &LPUART_InitStruct);
+  LL_LPUART_Enable(LPUART1);
+}
+#endif
+
+#ifdef TRACE_UART
+/**
+  * @brief USART2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_USART2_Init(void)
+{
+  LL_USART_InitTypeDef USART_InitStruct = {0};
+  LL_GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  LL_RCC_SetUSARTClockSource(LL_RCC_USART2_CLKSOURCE_PCLK1);
+
+  /* Peripheral clock enable */
+  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_USART2);
+
+  /**USART2 GPIO Configuration
+  PA14   ------> USART2_TX
+  */
+  GPIO_InitStruct.Pin = LL_GPIO_PIN_14;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_ALTERNATE;
+  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_VERY_HIGH;
+  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
+  GPIO_InitStruct.Alternate = LL_GPIO_AF_4;
+  LL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  /* USART2 DMA Init */
+
+  /* USART2_TX Init */
+  LL_DMA_SetPeriphRequest(DMA1, LL_DMA_CHANNEL_4, LL_DMA_REQUEST_4);
+  LL_DMA_SetDataTransferDirection(DMA1, LL_DMA_CHANNEL_4, LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+  LL_DMA_SetChannelPriorityLevel(DMA1, LL_DMA_CHANNEL_4, LL_DMA_PRIORITY_LOW);
+  LL_DMA_SetMode(DMA1, LL_DMA_CHANNEL_4, LL_DMA_MODE_NORMAL);
+  LL_DMA_SetPeriphIncMode(DMA1, LL_DMA_CHANNEL_4, LL_DMA_PERIPH_NOINCREMENT);
+  LL_DMA_SetMemoryIncMode(DMA1, LL_DMA_CHANNEL_4, LL_DMA_MEMORY_INCREMENT);
+  LL_DMA_SetPeriphSize(DMA1, LL_DMA_CHANNEL_4, LL_DMA_PDATAALIGN_BYTE);
+  LL_DMA_SetMemorySize(DMA1, LL_DMA_CHANNEL_4, LL_DMA_MDATAALIGN_BYTE);
+
+  /* DMA1_Channel4_5_IRQn interrupt configuration */
+  NVIC_SetPriority(DMA1_Channel4_5_IRQn, PRIORITY_BACKGROUND);
+  NVIC_EnableIRQ(DMA1_Channel4_5_IRQn);
+
+  USART_InitStruct.BaudRate = 115200;
+  USART_InitStruct.DataWidth = LL_USART_DATAWIDTH_8B;
+  USART_InitStruct.StopBits = LL_USART_STOPBITS_1;
+  USART_InitStruct.Parity = LL_USART_PARITY_NONE;
+  USART_InitStruct.TransferDirection = LL_USART_DIRECTION_TX;
+  USART_InitStruct.HardwareFlowControl = LL_USART_HWCONTROL_NONE;
+  USART_InitStruct.OverSampling = LL_USART_OVERSAMPLING_16;
+  LL_USART_Init(USART2, &USART_InitStruct);
+  LL_USART_ConfigAsyncMode(USART2);
+  LL_USART_Enable(USART2);
+}
+#endif
+
+/* USER CODE BEGIN 4 */
+
+/* USER CODE END 4 */
+
+/**
+  * @brief  This function is executed in case of error occurrence.
+  * @retval None
+  */
+void Error_Handler(void)
+{
+  /* USER CODE BEGIN Error_Handler_Debug */
+  /* User can add his own implementation to report the HAL error return state */
+
+  /* USER CODE END Error_Handler_Debug */
+}
+
+#ifdef  USE_FULL_ASSERT
+/**
+  * @brief  Reports the name of the source file and the source line number
+  *         where the assert_param error has occurred.
+  * @param  file: pointer to the source file name
+  * @param  line: assert_param error line source number
+  * @retval None
+  */
+void assert_failed(uint8_t *file, uint32_t line)
+{
+  /* USER CODE BEGIN 6 */
+  /* User can add his own implementation to report the file name and line number,
+     tex: printf("Wrong parameters value: file %s on line %d\r\n", file, line) */
+  /* USER CODE END 6 */
+}
+#endif /* USE_FULL_ASSERT */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// profile.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "profile.h"
+
+#ifdef PROFILE
+
+// read from the debugger, ~24 bytes a region out of the 2K
+volatile profile_t profile[prof_regions];
+uint32_t profile_overhead = 0;
+
+void profileBegin(prof_region_t region) {
+  uint32_t now = cycles();
+  // 0 means not started, a begin that lands exactly on it just loses one sample
+  profile[ region ].at = now;
+}
+
+void profileEnd(prof_region_t region) {
+  uint32_t now = cycles();
+  volatile profile_t *p = &profile[ region ];
+  if ( p->at == 0 ) {
+    return;
+  }
+  uint32_t spent = now - p->at;
+  spent = ( spent > profile_overhead ) ? spent - profile_overhead : 0;
+  p->at = 0;
+  if ( p->count == 0 || spent < p->min ) {
+    p->min = spent;
+  }
+  if ( spent > p->max ) {
+    p->max = spent;
+  }
+  p->total += spent;
+  p->count++;
+}
+
+void profileLap(prof_region_t region) {
+  profileEnd( region );
+  profileBegin( region );
+}
+
+void profileStart(void) {
+  for (int i=0; i<prof_regions; i++) {
+    profile[ i ] = (profile_t){0};
+  }
+  // what a begin and end around nothing costs, with interrupts held off so it's only that
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  profileBegin( prof_loop );
+  profileEnd( prof_loop );
+  profile_overhead = profile[ prof_loop ].min;
+  profile[ prof_loop ] = (profile_t){0};
+  __set_PRIMASK( primask );
+}
+
+#endif // PROFILE
@@ -0,0 +1,744 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// stepper.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "stepper.h"
+#include "trace.h"
+
+
+// S_STEP is TIM2_CH3 in PWM mode 1, each update event starts a STEP_PULSE_TICKS high pulse.
+// CCR3 and ARR are preloaded so anything written at an update takes effect on the following
+// period. The period for the pulse after next is written into ARR either by the update
+// interrupt or, for the bulk of a run, by DMA1 channel 2 on the TIM2_UP request from a ring
+// that is refilled half at a time. The last few pulses always go back to the interrupt so
+// the run ends on an exact pulse count. Periods come from a fixed rate, a table of segments
+// or the planner below.
+//
+// TIM2 puts OC3REF out on TRGO and TIM21, in external clock mode 1 off ITR0, counts every
+// pulse. Position is the count since the run started, so it is exact at any moment without
+// touching each step, and the opto edge is a compare on TIM21 channel 1.
+//
+// The drv8825 indexer walks a 128 entry table of 1/32 steps, home is entry 16 (45 degrees)
+// and a 1/n step size only lands on entries a whole 32/n apart from it. Changing size off
+// that grid makes the next pulse stop short on the next entry the new size allows, so the
+// indexer's phase is tracked against position and the first pulse of a run is counted
+// short if need be. Built with STEP_COARSE a planned move at 1/32 goes to the coarsest size
+// that still steps at STEP_SMOOTH_PPS once it's fast enough, on a pulse where the phase is on
+// that size's grid, and comes back to 1/32 as far from the end as it went coarse from the
+// start. The size is switched on the exact pulse by a compare on TIM21 channel 2.
+
+#define STEP_DMA_LEN                        64
+#define STEP_DMA_HALF                       (STEP_DMA_LEN/2)
+
+#ifdef STEP_COARSE
+// below this many pulses a second a size is too coarse to run smoothly. there's only the one
+// change each way, so 1/32 has to be quick enough to reach the coarse size's smooth speed
+// and the compare has to keep up with it there, which 1/4 at ~26000 pulses/s still does
+#define STEP_SMOOTH_PPS                     3200
+#define STEP_COARSEST                       step_size_4th
+#endif
+
+void myStepperDone(void);
+void myStepperOpto(void);
+void myIRQ_TIM21_UP(void);
+void myIRQ_TIM21_CC1(void);
+#ifdef STEP_COARSE
+void myIRQ_TIM21_CC2(void);
+#endif
+
+static volatile uint32_t pulses_left = 0;
+static volatile bool busy = false;
+// any stop sets stopped, so a run still being set up when an edge interrupt stops us
+// doesn't arm after it. a halt holds off every run until it's lifted
+static volatile bool stopped = false;
+static volatile bool halted = false;
+
+static uint16_t dma_ring[STEP_DMA_LEN];
+static uint32_t dma_left = 0;
+static uint8_t dma_half = 0;
+
+static uint16_t (*nextReload)(void);
+
+static const step_segment_t *segment;
+static int segment_count = 0;
+static uint32_t segment_pulses = 0;
+static uint16_t fixed_reload;
+
+static int microsteps = 1;
+// usteps a pulse at that size, shifted rather than divided out of microsteps
+static uint8_t size_usteps = USTEPS_PER_STEP;
+static int32_t step_unit = USTEPS_PER_STEP;
+// position at origin_count, the first pulse after it goes skew further than step_unit,
+// and the counts TIM21 has wrapped since it was zeroed
+static int32_t origin = 0;
+static uint32_t origin_count = 0;
+static int32_t skew = 0;
+static volatile uint32_t count_hi = 0;
+// position the indexer was last at its home entry
+static int32_t phase_origin = 0;
+
+#ifdef STEP_COARSE
+// size changes the planner has queued for the compare, at most one each way per move
+static uint32_t size_at[2];
+static step_size_t size_to[2];
+static volatile uint8_t size_put = 0;
+static volatile uint8_t size_take = 0;
+#endif
+
+// the planner runs integer only, velocity is 1/32 steps/s and the ramp clock is in units
+// of 64 step timer ticks so a ramp of up to ~2.1s still fits the 15 bit fraction math.
+// a profile asking for longer gets that, accelerating harder rather than wrapping
+#define RAMP_TICK_SHIFT                     6
+#define RAMP_TIME_MAX                       (UINT32_MAX >> 15)
+
+typedef enum {
+    phase_accel = 0,
+    phase_cruise = 1,
+    phase_decel = 2
+} phase_t;
+
+static struct {
+    uint32_t left;        // usteps not yet planned
+    uint32_t ramped;      // usteps it took to accelerate
+    uint32_t t;           // step timer ticks into the ramp
+    uint32_t ramp_time;   // ramp length in ramp ticks
+    uint32_t start;
+    uint32_t delta;
+    uint32_t speed;
+    uint16_t cruise;
+    uint8_t unit;         // usteps a pulse at the size being planned
+    uint8_t fine;
+#ifdef STEP_COARSE
+    uint32_t up;          // velocity to go coarse at
+    uint32_t head;        // usteps at the fine size before going coarse
+    uint32_t tail;        // and after, left when it goes back
+    uint32_t align;       // left is on the coarse grid when it matches this
+    uint32_t pulses;      // planned so far
+    uint8_t coarse;
+    step_size_t coarse_size;
+#endif
+    ramp_t ramp;
+    phase_t phase;
+} plan;
+
+static volatile bool decelerate = false;
+
+static volatile bool opto_armed = false;
+static int32_t opto_at = 0;
+static uint32_t opto_count = 0;
+
+
+// pulses since the run started
+static uint32_t pulseCount(void) {
+  uint32_t cnt = LL_TIM_GetCounter( TIM21 );
+  if ( LL_TIM_IsActiveFlag_UPDATE( TIM21 ) ) {
+    // wrapped but the interrupt hasn't run yet, read again past the wrap
+    cnt = LL_TIM_GetCounter( TIM21 ) + 0x10000;
+  }
+  return count_hi + cnt;
+}
+
+static void zeroCount(void) {
+  LL_TIM_SetCounter( TIM21, 0 );
+  LL_TIM_ClearFlag_UPDATE( TIM21 );
+  count_hi = 0;
+}
+
+// put the armed position on the TIM21 compare for the direction we're going
+static void optoCompare(void) {
+  LL_TIM_DisableIT_CC1( TIM21 );
+  if ( !opto_armed ) {
+    return;
+  }
+  int32_t unit = (step_unit < 0) ? -step_unit : step_unit;
+  int32_t ahead = (step_unit < 0) ? origin - opto_at : opto_at - origin;
+  ahead -= (step_unit < 0) ? -skew : skew;
+  uint32_t count = origin_count;
+#ifdef STEP_COARSE
+  // past any size change still to come, the count goes on at the new size
+  for (uint8_t n = size_take; n != size_put; n++) {
+    int32_t span = (int32_t)(size_at[n&1] - count) * unit;
+    if ( ahead <= span ) {
+      break;
+    }
+    ahead -= span;
+    count = size_at[n&1];
+    unit = USTEPS_PER_STEP >> size_to[n&1];
+  }
+#endif
+  opto_count = count + (( ahead > 0 ) ? (uint32_t)(ahead + unit - 1) / unit : 0);
+  LL_TIM_OC_SetCompareCH1( TIM21, opto_count & 0xFFFF );
+  LL_TIM_ClearFlag_CC1( TIM21 );
+  LL_TIM_EnableIT_CC1( TIM21 );
+  if ( opto_count <= pulseCount() ) {
+    // already there, let the interrupt have it now
+    LL_TIM_GenerateEvent_CC1( TIM21 );
+  }
+}
+
+static int32_t positionAt(uint32_t count) {
+  int32_t n = count - origin_count;
+  return n ? origin + n * step_unit + skew : origin;
+}
+
+// count from here at unit, the first pulse only gets as far as the next entry of the
+// indexer table that size allows
+static void rebase(uint32_t count, int32_t unit) {
+  origin = positionAt( count );
+  origin_count = count;
+  step_unit = unit;
+  int32_t u = (unit < 0) ? -unit : unit;
+  int32_t off = (origin - phase_origin) & (u-1);
+  skew = ( off == 0 ) ? 0 : ( unit > 0 ) ? -off : u - off;
+}
+
+// all three in one store, one at a time the drv8825 could take a step at a size in between
+static void sizePins(step_size_t sz) {
+  pinsAssign( S_M0_GPIO_Port, S_M0_Pin | S_M1_Pin | S_M2_Pin,
+              PIN_IF(sz&0x01, S_M0_Pin) | PIN_IF(sz&0x02, S_M1_Pin) | PIN_IF(sz&0x04, S_M2_Pin) );
+  microsteps = 1 << sz;
+  size_usteps = USTEPS_PER_STEP >> sz;
+}
+
+#ifdef STEP_COARSE
+// put the next queued size change on the TIM21 channel 2 compare
+static void sizeCompare(void) {
+  LL_TIM_DisableIT_CC2( TIM21 );
+  if ( size_take == size_put ) {
+    return;
+  }
+  uint32_t at = size_at[size_take&1];
+  LL_TIM_OC_SetCompareCH2( TIM21, at & 0xFFFF );
+  LL_TIM_ClearFlag_CC2( TIM21 );
+  LL_TIM_EnableIT_CC2( TIM21 );
+  if ( at <= pulseCount() ) {
+    LL_TIM_GenerateEvent_CC2( TIM21 );
+  }
+}
+
+// pulses after the count'th are at size sz, from the planner which is well ahead of the pulses
+static void sizeAt(uint32_t count, step_size_t sz) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  size_at[size_put&1] = count;
+  size_to[size_put&1] = sz;
+  size_put++;
+  sizeCompare();
+  optoCompare();
+  __set_PRIMASK( primask );
+}
+
+// called from stm32l0xx_it.c on TIM21 compare, the last pulse at the old size has started
+void myIRQ_TIM21_CC2(void) {
+  while ( size_take != size_put ) {
+    uint8_t n = size_take & 1;
+    if ( pulseCount() < size_at[n] ) {
+      // matched early off a wrap
+      break;
+    }
+    // the drv8825 takes the mode pins on the next STEP edge. if this ran late the pulses
+    // since went at the old size, the count is folded where it is and the first pulse at
+    // the new size comes out short onto its grid, position stays right and the move ends
+    // a little off
+    sizePins( size_to[n] );
+    int32_t unit = USTEPS_PER_STEP >> size_to[n];
+    rebase( pulseCount(), (step_unit < 0) ? -unit : unit );
+    size_take++;
+  }
+  sizeCompare();
+  optoCompare();
+}
+#endif
+
+// called from stm32l0xx_it.c when TIM21 wraps
+void myIRQ_TIM21_UP(void) {
+  count_hi += 0x10000;
+}
+
+// called from stm32l0xx_it.c on TIM21 compare, the pulse count reached the opto edge
+void myIRQ_TIM21_CC1(void) {
+  // the compare is only 16 bits, a long run can match a wrap early
+  if ( opto_armed && pulseCount() >= opto_count ) {
+    opto_armed = false;
+    LL_TIM_DisableIT_CC1( TIM21 );
+    myStepperOpto();
+  }
+}
+
+void stepperOptoAt(int32_t at) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  opto_at = at;
+  opto_armed = true;
+  if ( busy ) {
+    optoCompare();
+  }
+  __set_PRIMASK( primask );
+}
+
+void stepperOptoOff(void) {
+  opto_armed = false;
+  LL_TIM_DisableIT_CC1( TIM21 );
+}
+
+int32_t stepperPosition(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  int32_t at = positionAt( pulseCount() );
+  __set_PRIMASK( primask );
+  return at;
+}
+
+void stepperSetPosition(int32_t at) {
+  // the indexer hasn't moved, only what its place is called
+  phase_origin += at - positionAt( pulseCount() );
+  origin = at;
+  origin_count = 0;
+  skew = 0;
+  zeroCount();
+}
+
+void stepperPhaseHome(void) {
+  phase_origin = stepperPosition();
+}
+
+int32_t stepperPhaseHomeAt(void) {
+  int32_t at = stepperPosition();
+  return at + (((phase_origin - at + 2*USTEPS_PER_STEP) & (4*USTEPS_PER_STEP - 1)) - 2*USTEPS_PER_STEP);
+}
+
+static void planStretch(int32_t usteps);
+
+void stepperShift(int32_t usteps) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  origin += usteps;
+  phase_origin += usteps;
+  if ( busy ) {
+    optoCompare();
+    // a count further along has that much less to go
+    planStretch( (step_unit < 0) ? usteps : -usteps );
+  }
+  __set_PRIMASK( primask );
+}
+
+void stepperDirection(step_dir_t dir) {
+  pinsAssign( S_DIR_GPIO_Port, S_DIR_Pin, PIN_IF(dir, S_DIR_Pin) );
+  step_unit = size_usteps;
+  if ( dir == step_dir_down ) {
+    step_unit = -step_unit;
+  }
+}
+
+int stepSize(step_size_t sz) {
+  // 0=full, 1=1/2 step, 2=1/4 step, 3=1/8th step, 4=1/16th, 5,6,7=32th
+  sizePins( sz );
+  step_unit = (step_unit < 0) ? -size_usteps : size_usteps;
+  return microsteps;
+}
+
+static uint16_t fixedReload(void) {
+  return fixed_reload;
+}
+
+// auto reload value for the next period of a segment table
+static uint16_t segmentReload(void) {
+  while ( segment_pulses == 0 && segment_count > 1 ) {
+    segment++;
+    segment_count--;
+    segment_pulses = segment->pulses;
+  }
+  if ( segment_pulses ) {
+    segment_pulses--;
+  }
+  return segment->period-1;
+}
+
+static void fillRing(int half) {
+  uint16_t *p = &dma_ring[ half * STEP_DMA_HALF ];
+  for (int i=0; i<STEP_DMA_HALF; i++) {
+    p[i] = nextReload();
+  }
+}
+
+// period for a pulse of the size being planned at velocity v
+static uint16_t velocityReload(uint32_t v) {
+  uint32_t period = STEP_TIMER_HZ * plan.unit / v;
+  return ( period > 0xFFFF ) ? 0xFFFF : period-1;
+}
+
+// velocity along the ramp at time t, 1.15 fixed point fraction of the way through
+static uint32_t rampVelocity(void) {
+  uint32_t tau = plan.t >> RAMP_TICK_SHIFT;
+  if ( tau > plan.ramp_time ) {
+    tau = plan.ramp_time;
+  }
+  uint32_t x = (tau << 15) / plan.ramp_time;
+  if ( plan.ramp == ramp_scurve ) {
+    // smoothstep 3x^2-2x^3, acceleration ramps in and out so jerk stays bounded
+    x = ((x*x >> 15) * (3*32768 - 2*x)) >> 15;
+  }
+  return plan.start + ((plan.delta * x) >> 15);
+}
+
+// pulses not yet planned
+static uint32_t planPulses(void) {
+#ifdef STEP_COARSE
+  if ( plan.unit != plan.fine ) {
+    return (plan.left - plan.tail) / plan.unit + plan.tail / plan.fine;
+  }
+#endif
+  return plan.left / plan.fine;
+}
+
+// auto reload value for the next period of a planned move
+static uint16_t planReload(void) {
+  uint32_t left = plan.left;
+  uint32_t unit = plan.unit;
+  plan.left -= unit;
+  if ( plan.phase != phase_decel && left <= plan.ramped ) {
+    // as far from the end as it took to get up to speed, or half way on a short move
+    plan.phase = phase_decel;
+  }
+  uint32_t v = ( plan.phase == phase_cruise ) ? plan.speed : rampVelocity();
+
+#ifdef STEP_COARSE
+  plan.pulses++;
+  // the size of the next pulse, going coarse leaves a fine tail as long as the fine head
+  if ( unit != plan.fine ) {
+    if ( plan.left == plan.tail ) {
+      plan.unit = plan.fine;
+      plan.up = UINT32_MAX;
+      sizeAt( plan.pulses, step_size_32nd );
+      plan.cruise = velocityReload( plan.speed );
+    }
+  } else if ( v >= plan.up && plan.phase != phase_decel &&
+              ((plan.left - plan.align) & (plan.coarse-1)) == 0 ) {
+    uint32_t head = plan.head - plan.left;
+    if ( plan.left >= head + plan.coarse ) {
+      plan.head = head;
+      plan.tail = head + ((plan.left - head) & (plan.coarse-1));
+      plan.unit = plan.coarse;
+      sizeAt( plan.pulses, plan.coarse_size );
+      plan.cruise = velocityReload( plan.speed );
+    }
+  }
+#endif
+  if ( plan.phase == phase_cruise ) {
+    return plan.cruise;
+  }
+
+  uint16_t reload = velocityReload( v );
+  uint32_t period = reload+1;
+  if ( plan.phase == phase_accel ) {
+    plan.ramped += unit;
+    plan.t += period;
+    if ( (plan.t >> RAMP_TICK_SHIFT) >= plan.ramp_time ) {
+      plan.phase = phase_cruise;
+    }
+  } else {
+    plan.t = ( plan.t > period ) ? plan.t-period : 0;
+  }
+  return reload;
+}
+
+// cut the plan down to a deceleration from the current speed
+static void shortenPlan(void) {
+  decelerate = false;
+#ifdef STEP_COARSE
+  plan.up = UINT32_MAX;
+#endif
+  if ( plan.left > plan.ramped ) {
+    // mirror of the ramp so far, ramped is how far it took to get to this speed
+    plan.phase = phase_decel;
+    plan.left = plan.ramped;
+#ifdef STEP_COARSE
+    if ( plan.unit != plan.fine ) {
+      if ( plan.ramped >= plan.head + plan.unit ) {
+        plan.tail = plan.head + ((plan.ramped - plan.head) & (plan.unit-1));
+      } else {
+        // the next pulse is already coarse, that and the tail as it was
+        plan.left = plan.unit + plan.tail;
+      }
+    }
+#endif
+  }
+}
+
+// a planned move goes usteps further, or less far for negative, still in whole pulses at
+// the fine size. the interrupts recount what's left from plan.left each period or ring
+// half so the new end is picked up from there
+static void planStretch(int32_t usteps) {
+  if ( nextReload != planReload ) {
+    return;
+  }
+  int32_t d = usteps & ~(int32_t)(plan.fine - 1);
+  if ( d < 0 && (uint32_t)-d > plan.left ) {
+    d = -(int32_t)plan.left;
+  }
+#ifdef STEP_COARSE
+  if ( plan.unit != plan.fine ) {
+    // coarse now, only the fine tail can give
+    if ( d < 0 && (uint32_t)-d > plan.tail ) {
+      d = -(int32_t)plan.tail;
+    }
+    plan.tail += d;
+  } else {
+    plan.head += d;
+  }
+  plan.align += d;
+#endif
+  plan.left += d;
+}
+
+// called from stm32l0xx_it.c on TIM2 update, a new period has just started
+void myIRQ_TIM2(void) {
+  if ( pulses_left == 0 ) {
+    // this is the silent period after the last pulse
+    stepperStop();
+    TRACE( trace_done, TRACE_ZIGZAG( stepperPosition() ) );
+    myStepperDone();
+    return;
+  }
+  pulses_left--;
+  if ( pulses_left && nextReload == planReload ) {
+    // nothing past this period is planned yet, so what's left is exactly the planner's count
+    if ( decelerate ) {
+      shortenPlan();
+      TRACE( trace_decel, planPulses() );
+    }
+    pulses_left = planPulses();
+  }
+  if ( pulses_left == 0 ) {
+    // keep the next period low
+    LL_TIM_OC_SetCompareCH3( TIM2, 0 );
+  } else {
+    LL_TIM_SetAutoReload( TIM2, nextReload() );
+  }
+}
+
+// called from stm32l0xx_it.c on DMA1 channel 2 half or full transfer, half the ring went out
+void myIRQ_DMA_2_3(void) {
+  if ( dma_left == 0 ) {
+    // left pending by a stop from lower down
+    return;
+  }
+  dma_left -= STEP_DMA_HALF;
+  if ( dma_left == 0 ) {
+    // ARR already holds the period after this one, the interrupt takes it from here
+    LL_TIM_DisableDMAReq_UPDATE( TIM2 );
+    LL_DMA_DisableChannel( DMA1, LL_DMA_CHANNEL_2 );
+    LL_TIM_ClearFlag_UPDATE( TIM2 );
+    LL_TIM_EnableIT_UPDATE( TIM2 );
+    dma_half ^= 1;
+    return;
+  }
+  if ( nextReload == planReload ) {
+    // the other half of the ring and ARR are already planned, recount around the end,
+    // which comes sooner once the planner goes coarse or is told to stop
+    if ( decelerate ) {
+      shortenPlan();
+      TRACE( trace_decel, planPulses() );
+    }
+    uint32_t total = STEP_DMA_HALF + 1 + planPulses();
+    dma_left = ((total-1) / STEP_DMA_HALF) * STEP_DMA_HALF;
+    pulses_left = total - dma_left;
+  }
+  TRACE( trace_refill, dma_left );
+  if ( dma_left > STEP_DMA_HALF ) {
+    fillRing( dma_half );
+  }
+  dma_half ^= 1;
+}
+
+static void run(uint32_t pulses) {
+  if ( pulses == 0 || halted ) {
+    return;
+  }
+  stopped = false;
+  TRACE( trace_run, pulses );
+
+  // count from here, direction is fixed until the run is done and only the planner's
+  // compare changes the step size
+  stepperSetPosition( stepperPosition() );
+  rebase( 0, step_unit );
+#ifdef STEP_COARSE
+  size_take = size_put;
+#endif
+  busy = true;
+  optoCompare();
+
+  LL_TIM_SetAutoReload( TIM2, nextReload() );
+  LL_TIM_OC_SetCompareCH3( TIM2, STEP_PULSE_TICKS );
+  LL_TIM_SetCounter( TIM2, 0 );
+  // load the preloads, update source is counter overflow only so this doesn't interrupt
+  LL_TIM_GenerateEvent_UPDATE( TIM2 );
+
+  // first pulse goes out as soon as the counter is enabled
+  pulses_left = pulses-1;
+  if ( pulses_left == 0 ) {
+    LL_TIM_OC_SetCompareCH3( TIM2, 0 );
+  } else {
+    LL_TIM_SetAutoReload( TIM2, nextReload() );
+  }
+
+  // whole halves of the ring are streamed, always leaving at least one pulse for the interrupt
+  dma_left = pulses_left ? ((pulses_left-1) / STEP_DMA_HALF) * STEP_DMA_HALF : 0;
+  LL_TIM_ClearFlag_UPDATE( TIM2 );
+  if ( dma_left ) {
+    pulses_left -= dma_left;
+    dma_half = 0;
+    fillRing( 0 );
+    if ( dma_left > STEP_DMA_HALF ) {
+      fillRing( 1 );
+    }
+    LL_DMA_ConfigAddresses( DMA1, LL_DMA_CHANNEL_2, (uint32_t)dma_ring, (uint32_t)&TIM2->ARR, LL_DMA_DIRECTION_MEMORY_TO_PERIPH );
+    LL_DMA_SetDataLength( DMA1, LL_DMA_CHANNEL_2, STEP_DMA_LEN );
+  }
+
+  // armed under the same mask stepperStop takes, and not at all if one got in first
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if ( stopped || halted ) {
+    // undo whatever was set up after it
+    stepperStop();
+  } else {
+    if ( dma_left ) {
+      LL_DMA_EnableChannel( DMA1, LL_DMA_CHANNEL_2 );
+      LL_TIM_EnableDMAReq_UPDATE( TIM2 );
+    } else {
+      LL_TIM_EnableIT_UPDATE( TIM2 );
+    }
+    LL_TIM_EnableCounter( TIM2 );
+  }
+  __set_PRIMASK( primask );
+}
+
+void stepperStream(const step_segment_t *segments, int count) {
+  stepperWait();
+
+  uint32_t pulses = 0;
+  for (int i=0; i<count; i++) {
+    pulses += segments[i].pulses;
+  }
+  segment = segments;
+  segment_count = count;
+  segment_pulses = segments->pulses;
+  nextReload = segmentReload;
+  run( pulses );
+}
+
+void stepperMove(uint32_t usteps, const step_profile_t *profile) {
+  stepperWait();
+
+  uint32_t start = profile->start * USTEPS_PER_STEP;
+  uint32_t speed = profile->speed * USTEPS_PER_STEP;
+  if ( speed < start ) {
+    speed = start;
+  }
+  plan.fine = size_usteps;
+  plan.unit = plan.fine;
+  plan.left = usteps - usteps % plan.fine;
+  plan.ramped = 0;
+  plan.t = 0;
+  plan.start = start;
+  plan.delta = speed - start;
+  plan.speed = speed;
+  plan.ramp_time = plan.delta * (STEP_TIMER_HZ >> RAMP_TICK_SHIFT) / (profile->accel * USTEPS_PER_STEP);
+  if ( profile->ramp == ramp_scurve ) {
+    // same peak acceleration as the trapezoid takes half as long again
+    plan.ramp_time = plan.ramp_time * 3 / 2;
+  }
+  if ( plan.ramp_time > RAMP_TIME_MAX ) {
+    plan.ramp_time = RAMP_TIME_MAX;
+  }
+#ifdef STEP_COARSE
+  plan.head = plan.left;
+  plan.tail = 0;
+  plan.pulses = 0;
+  plan.up = UINT32_MAX;
+  if ( plan.fine == 1 ) {
+    // the coarsest size still smooth at cruise, gone to at the speed it's just smooth at
+    step_size_t sz = step_size_32nd;
+    while ( sz > STEP_COARSEST && (profile->speed << (sz-1)) >= STEP_SMOOTH_PPS ) {
+      sz--;
+    }
+    if ( sz != step_size_32nd ) {
+      plan.coarse_size = sz;
+      plan.coarse = USTEPS_PER_STEP >> sz;
+      plan.up = STEP_SMOOTH_PPS * plan.coarse;
+      // the phase is on the coarse grid after d usteps when left matches this
+      int32_t rel = stepperPosition() - phase_origin;
+      plan.align = plan.left + ((step_unit < 0) ? -rel : rel);
+    }
+  }
+#endif
+  plan.cruise = velocityReload( speed );
+  plan.ramp = profile->ramp;
+  plan.phase = plan.ramp_time ? phase_accel : phase_cruise;
+  nextReload = planReload;
+  decelerate = false;
+  run( planPulses() );
+}
+
+void stepperDecelerate(void) {
+  // only a planned move knows how to slow down, a fixed rate run just finishes
+  if ( busy && nextReload == planReload ) {
+    decelerate = true;
+  }
+}
+
+void stepperStart(uint32_t pulses, uint32_t period) {
+  stepperWait();
+  // a one segment table would do, but then nothing else needs the table walk linked in
+  fixed_reload = period-1;
+  nextReload = fixedReload;
+  run( pulses );
+}
+
+void stepperStop(void) {
+  // the fault and limit edges stop us from below the step interrupts, which mustn't see
+  // it half done
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  LL_TIM_DisableCounter( TIM2 );
+  LL_TIM_DisableIT_UPDATE( TIM2 );
+  LL_TIM_DisableDMAReq_UPDATE( TIM2 );
+  LL_DMA_DisableChannel( DMA1, LL_DMA_CHANNEL_2 );
+  LL_TIM_OC_SetCompareCH3( TIM2, 0 );
+  LL_TIM_GenerateEvent_UPDATE( TIM2 );
+#ifdef STEP_COARSE
+  LL_TIM_DisableIT_CC2( TIM21 );
+  size_take = size_put;
+#endif
+  pulses_left = 0;
+  dma_left = 0;
+  decelerate = false;
+  // fold the count back into the position before direction or step size can change
+  stepperSetPosition( stepperPosition() );
+  busy = false;
+  stopped = true;
+  __set_PRIMASK( primask );
+}
+
+void stepperHalt(void) {
+  halted = true;
+  stepperStop();
+}
+
+void stepperResume(void) {
+  halted = false;
+}
+
+bool stepperBusy(void) {
+  return busy;
+}
+
+void stepperWait(void) {
+  while ( busy );
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// timebase.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "timebase.h"
+
+// LPTIM1 only counts 16 bits, the match on its auto reload keeps the rest. its clock isn't
+// the bus clock so a counter read is only good when two in a row agree
+
+void myIRQ_LPTIM1(void);
+
+static volatile uint32_t count_hi = 0;
+
+static uint32_t count(void) {
+  uint32_t a, b;
+  do {
+    a = LL_LPTIM_GetCounter( LPTIM1 );
+    b = LL_LPTIM_GetCounter( LPTIM1 );
+  } while ( a != b );
+  return a;
+}
+
+// called from stm32l0xx_it.c when LPTIM1 reaches 0xFFFF, the next count is the wrap. until
+// then micros() takes the lap back off
+void myIRQ_LPTIM1(void) {
+  count_hi += 0x10000;
+}
+
+uint32_t micros(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t cnt = count();
+  if ( LL_LPTIM_IsActiveFlag_ARRM( LPTIM1 ) ) {
+    if ( cnt < 0x8000 ) {
+      // wrapped but the interrupt hasn't run yet
+      cnt += 0x10000;
+    }
+  } else if ( cnt == 0xFFFF ) {
+    // the match flags the last count of the lap, not the first of the next, so an interrupt
+    // that's already taken it has added the lap a count early
+    cnt -= 0x10000;
+  }
+  uint32_t us = count_hi + cnt;
+  __set_PRIMASK( primask );
+  return us;
+}
+
+void delayUs(uint32_t us) {
+  // the count could tick right after we read it, so one more to be sure of the whole wait
+  uint32_t at = micros() + us + 1;
+  while ( !deadlinePassed( at ) );
+}
+
+void timebaseStart(void) {
+  LL_LPTIM_Enable( LPTIM1 );
+  LL_LPTIM_SetAutoReload( LPTIM1, 0xFFFF );
+  LL_LPTIM_EnableIT_ARRM( LPTIM1 );
+  LL_LPTIM_StartCounter( LPTIM1, LL_LPTIM_OPERATING_MODE_CONTINUOUS );
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// trace.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "timebase.h"
+#include "trace.h"
+
+#ifdef TRACE_UART
+
+// events are packed into a ring as they happen and DMA1 channel 4 sends whatever is there
+// in the background, one contiguous stretch at a time, restarted from its own transfer
+// complete. 115200 baud is ~11 bytes/ms, a move at speed is a refill every ~1ms so the
+// ring only has to ride out bursts. when it's full events are counted and dropped rather
+// than ever waiting in an interrupt
+
+#define TRACE_LEN                  128
+#define TRACE_EVENT_MAX            11
+
+void myIRQ_DMA_4_5(void);
+
+static uint8_t ring[TRACE_LEN];
+static uint8_t head = 0;
+static uint8_t tail = 0;
+static uint8_t sending = 0;      // bytes the dma has from tail
+static uint32_t last_us = 0;
+static uint32_t lost = 0;
+
+static uint8_t *varint(uint8_t *p, uint32_t v) {
+  while ( v >= 0x80 ) {
+    *p++ = v | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+
+// send from tail up to head or the end of the ring, whichever comes first
+static void kick(void) {
+  if ( sending || head == tail ) {
+    return;
+  }
+  sending = ( head > tail ) ? head - tail : TRACE_LEN - tail;
+  LL_DMA_DisableChannel( DMA1, LL_DMA_CHANNEL_4 );
+  LL_DMA_SetMemoryAddress( DMA1, LL_DMA_CHANNEL_4, (uint32_t)&ring[ tail ] );
+  LL_DMA_SetDataLength( DMA1, LL_DMA_CHANNEL_4, sending );
+  LL_DMA_EnableChannel( DMA1, LL_DMA_CHANNEL_4 );
+}
+
+static void put(trace_t event, uint32_t arg, uint32_t now) {
+  uint8_t frame[TRACE_EVENT_MAX];
+  frame[0] = event;
+  uint8_t *end = varint( varint( &frame[1], now - last_us ), arg );
+  last_us = now;
+  for (uint8_t *p = frame; p < end; p++) {
+    ring[ head ] = *p;
+    head = (head + 1) % TRACE_LEN;
+  }
+}
+
+void traceEvent(trace_t event, uint32_t arg) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t now = micros();
+  uint8_t used = (head - tail + TRACE_LEN) % TRACE_LEN;
+  uint8_t room = TRACE_LEN - 1 - used;
+  if ( lost && room >= 2*TRACE_EVENT_MAX ) {
+    put( trace_lost, lost, now );
+    lost = 0;
+    room -= TRACE_EVENT_MAX;
+  }
+  if ( lost || room < TRACE_EVENT_MAX ) {
+    lost++;
+  } else {
+    put( event, arg, now );
+  }
+  kick();
+  __set_PRIMASK( primask );
+}
+
+// called from stm32l0xx_it.c on DMA1 channel 4 transfer complete
+void myIRQ_DMA_4_5(void) {
+  tail = (tail + sending) % TRACE_LEN;
+  sending = 0;
+  kick();
+}
+
+void traceStart(void) {
+  LL_DMA_SetPeriphAddress( DMA1, LL_DMA_CHANNEL_4, (uint32_t)&USART2->TDR );
+  LL_DMA_EnableIT_TC( DMA1, LL_DMA_CHANNEL_4 );
+  LL_USART_EnableDMAReq_TX( USART2 );
+  // the first delta is from zero, so it carries the absolute time
+  last_us = 0;
+  traceEvent( trace_start, 0 );
+}
+
+#endif // TRACE_UART
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tuning.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+#include "stepper.h"
+#include "tuning.h"
+
+#ifdef TUNING_UART
+
+// LPUART1 RX lands in a ring by DMA1 channel 3, circular, so nothing runs per byte. the
+// main loop follows the DMA count and replies are short enough to just send
+#define RX_LEN                     32
+
+static uint8_t rx_ring[RX_LEN];
+static uint8_t rx_tail = 0;
+static int16_t commit_id = -1;   // the commit waiting on its save
+
+// what a value has to be to be let anywhere near the planner
+static const struct {
+    int32_t min;
+    int32_t max;
+} limits[CONFIG_WORDS] = {
+  { -50, 50 },                            // press_steps, whole steps
+  { 1, 500 },                             // start, the last pulses of a run are an interrupt each
+  { 1, 2000 },                            // speed, *32 has to stay under ~68000 pulses/s
+  { 1500, 100000 },                       // accel, the 2000 s-curve ramp fits the planner's ~2.1s
+  { 0, 2*USTEPS_PER_LEVEL }, { 0, 2*USTEPS_PER_LEVEL },
+  { 0, 2*USTEPS_PER_LEVEL }, { 0, 2*USTEPS_PER_LEVEL },
+};
+
+static uint8_t sum(const uint8_t *frame) {
+  uint8_t s = 0;
+  for (int i=1; i<TUNING_FRAME-1; i++) {
+    s += frame[i];
+  }
+  return ~s;
+}
+
+static void send(uint8_t cmd, uint8_t id, int32_t value) {
+  uint8_t frame[TUNING_FRAME] = { TUNING_REPLY, cmd, id, value, value >> 8, value >> 16, value >> 24, 0 };
+  frame[TUNING_FRAME-1] = sum( frame );
+  for (int i=0; i<TUNING_FRAME; i++) {
+    while ( !LL_LPUART_IsActiveFlag_TXE( LPUART1 ) );
+    LL_LPUART_TransmitData8( LPUART1, frame[i] );
+  }
+}
+
+void tuningStart(void) {
+  LL_DMA_ConfigAddresses( DMA1, LL_DMA_CHANNEL_3, (uint32_t)&LPUART1->RDR, (uint32_t)rx_ring, LL_DMA_DIRECTION_PERIPH_TO_MEMORY );
+  LL_DMA_SetDataLength( DMA1, LL_DMA_CHANNEL_3, RX_LEN );
+  LL_DMA_EnableChannel( DMA1, LL_DMA_CHANNEL_3 );
+  LL_LPUART_EnableDMAReq_RX( LPUART1 );
+}
+
+bool tuningPoll(config_t *config) {
+  bool commit = false;
+  uint8_t head = RX_LEN - LL_DMA_GetDataLength( DMA1, LL_DMA_CHANNEL_3 );
+  while ( (uint8_t)(head - rx_tail + RX_LEN) % RX_LEN >= TUNING_FRAME ) {
+    uint8_t frame[TUNING_FRAME];
+    for (int i=0; i<TUNING_FRAME; i++) {
+      frame[i] = rx_ring[ (rx_tail + i) % RX_LEN ];
+    }
+    if ( frame[0] != TUNING_SYNC || frame[TUNING_FRAME-1] != sum( frame ) ) {
+      // out of step, slide along a byte until a frame lines up
+      rx_tail = (rx_tail + 1) % RX_LEN;
+      continue;
+    }
+    rx_tail = (rx_tail + TUNING_FRAME) % RX_LEN;
+
+    uint8_t cmd = frame[1];
+    uint8_t id = frame[2];
+    int32_t value = frame[3] | (frame[4] << 8) | (frame[5] << 16) | ((uint32_t)frame[6] << 24);
+    int32_t *words = (int32_t*)config;
+    if ( cmd == TUNING_COMMIT ) {
+      // answered by tuningSaved() once it's written
+      commit = true;
+      commit_id = id;
+    } else if ( id >= CONFIG_WORDS ) {
+      send( cmd | TUNING_REFUSED, id, 0 );
+    } else if ( cmd == TUNING_GET ) {
+      send( cmd, id, words[id] );
+    } else if ( cmd == TUNING_SET && value >= limits[id].min && value <= limits[id].max ) {
+      words[id] = value;
+      send( cmd, id, value );
+    } else {
+      send( cmd | TUNING_REFUSED, id, words[id] );
+    }
+  }
+  return commit;
+}
+
+void tuningSaved(bool ok) {
+  if ( commit_id >= 0 ) {
+    send( ok ? TUNING_COMMIT : TUNING_COMMIT | TUNING_REFUSED, commit_id, 0 );
+    commit_id = -1;
+  }
+}
+
+#endif // TUNING_UART
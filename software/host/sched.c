@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// sched.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "priority.h"
+
+// every handler in priority.h's worst case response against its deadline, the exit status
+// is 1 if any of them can miss it so the build stops there. nothing of the sim in it
+
+typedef struct {
+    const char *name;
+    int priority;
+    uint32_t cost;
+    uint32_t period;
+    uint32_t deadline;
+    int group;
+} handler_t;
+
+#define ROW(name, priority, cost, period, deadline, group) { name, priority, cost, period, deadline, group },
+static const handler_t handlers[] = { SCHED_HANDLERS(ROW) };
+#define HANDLERS                   (sizeof(handlers) / sizeof(handlers[0]))
+
+// the longest of the others at its own level that can be running when it comes in, the
+// nvic won't preempt for the same priority
+static uint32_t sameLevel(const handler_t *h) {
+  uint32_t worst = 0;
+  for (unsigned i=0; i<HANDLERS; i++) {
+    const handler_t *o = &handlers[i];
+    if ( o == h || o->priority != h->priority || (o->group && o->group == h->group) ) {
+      continue;
+    }
+    if ( o->cost > worst ) {
+      worst = o->cost;
+    }
+  }
+  return worst;
+}
+
+// what the levels above can put in over a window of r, a group as the most any one of it could
+static uint64_t above(const handler_t *h, uint64_t r) {
+  uint64_t sum = 0;
+  for (unsigned i=0; i<HANDLERS; i++) {
+    const handler_t *o = &handlers[i];
+    if ( o->priority >= h->priority ) {
+      continue;
+    }
+    bool first = true;
+    for (unsigned j=0; j<i; j++) {
+      first &= !( o->group && handlers[j].group == o->group );
+    }
+    if ( !first ) {
+      continue;
+    }
+    uint64_t most = 0;
+    for (unsigned j=i; j<HANDLERS; j++) {
+      const handler_t *m = &handlers[j];
+      if ( m != o && !(o->group && m->group == o->group) ) {
+        continue;
+      }
+      uint64_t c = (r + m->period - 1) / m->period * m->cost;
+      if ( c > most ) {
+        most = c;
+      }
+    }
+    sum += most;
+  }
+  return sum;
+}
+
+// iterated up from its own cost until it settles, or stops once it's past the deadline
+static uint64_t response(const handler_t *h) {
+  uint64_t fixed = h->cost + SCHED_BLOCKING + sameLevel( h );
+  uint64_t r = fixed;
+  while ( r <= h->deadline ) {
+    uint64_t next = fixed + above( h, r );
+    if ( next == r ) {
+      break;
+    }
+    r = next;
+  }
+  return r;
+}
+
+int main(void) {
+  int missed = 0;
+  printf( "%-14s %4s %8s %9s %9s %9s\n", "handler", "prio", "C", "T", "D", "R" );
+  for (unsigned i=0; i<HANDLERS; i++) {
+    const handler_t *h = &handlers[i];
+    uint64_t r = response( h );
+    bool miss = r > h->deadline;
+    printf( "%-14s %4d %8u %9u %9u %9llu%s\n", h->name, h->priority, h->cost, h->period, h->deadline,
+            (unsigned long long)r, miss ? "  misses" : "" );
+    missed += miss;
+  }
+  if ( missed ) {
+    printf( "sched: %d of %u handlers can miss their deadline\n", missed, (unsigned)HANDLERS );
+    return 1;
+  }
+  printf( "sched: all %u handlers meet their deadline\n", (unsigned)HANDLERS );
+  return 0;
+}
@@ -0,0 +1,885 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// sim.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "main.h"
+#include "stm32l0xx_it.h"
+#include "stepper.h"
+
+// just enough of the l011 for the firmware to run against: the registers it uses behave
+// the way the reference manual has them, the interrupts they raise are taken at their
+// NVIC priority through the real handlers in stm32l0xx_it.c, and a drv8825 on the step
+// pins moves a carriage. time only moves when the hardware has something to do, when the
+// loop sleeps or when thread code polls the timebase
+
+// only built with TRACE_UART, an unexpected interrupt if it ever fires without it
+void DMA1_Channel4_5_IRQHandler(void) __attribute__((weak));
+void LPTIM1_IRQHandler(void);
+
+#define THREAD                     4          // below every priority the NVIC has
+#define TDR_EMPTY                  0xFFFFFFFF
+#define UART_BYTE_TICKS            SIM_US(87) // 115200 baud, ten bits
+#define FLASH_WORD_TICKS           SIM_US(3200)
+#define SCRIPT_LEN                 1024
+#define CAPTURE_LEN                4096
+#define WATCHDOG_S                 30
+#define SYSTICK_PER_TICK           8          // 32MHz core clocks a 1/4us tick
+
+static const struct {
+    uintptr_t base;
+    size_t len;
+} regions[] = {
+    { DATA_EEPROM_BASE, 0x1000 },
+    { PERIPH_BASE, 0x24000 },    // APB1, APB2 and the AHB up to the CRC
+    { IOPPERIPH_BASE, 0x2000 },
+    { SCS_BASE, 0x1000 }
+};
+
+static uint64_t now = 0;
+static bool primask = false;
+static uint32_t running = THREAD;
+// set while the sim itself is doing things, so nothing it touches goes round again
+static int in_sim = 0;
+
+static struct {
+    bool on;
+    uint32_t arr;         // shadows of the preloaded registers
+    uint32_t ccr3;
+    uint64_t next;        // the next update
+} tim2;
+
+static struct {
+    bool on;
+    bool pending;
+    uint64_t next;
+} systick;
+
+static struct {
+    bool on;
+    uint64_t base;        // the time it counted 0 from
+    uint64_t next;        // the next match on ARR
+} lptim;
+
+static struct {
+    bool busy;
+    uint64_t at;
+    uint8_t before[DATA_EEPROM_END - DATA_EEPROM_BASE + 1];
+} flash;
+
+static struct {
+    uint32_t len;
+    uint32_t idx;
+} dma[5];
+static DMA_Channel_TypeDef *const channels[5] = {
+    DMA1_Channel1, DMA1_Channel2, DMA1_Channel3, DMA1_Channel4, DMA1_Channel5
+};
+static bool trace_on = false;
+static uint64_t trace_next;
+
+static struct {
+    uint64_t at;
+    void (*fn)(void);
+} script[SCRIPT_LEN];
+static int script_len = 0;
+
+// the drv8825 and what it's bolted to
+#define PHASE_HOME                 16
+static int phase = PHASE_HOME;
+static int32_t carriage = 0;
+static uint32_t pulses = 0;
+static bool limit_on = false;
+static int32_t limit_at = 0;
+
+static uint8_t uart_tx[CAPTURE_LEN];
+static size_t uart_tx_len = 0;
+static uint8_t trace_tx[CAPTURE_LEN];
+static size_t trace_tx_len = 0;
+
+void (*simOutput)(GPIO_TypeDef *port, uint32_t changed, uint32_t odr);
+void (*simStep)(void);
+void (*simFlashDone)(void);
+uint32_t simFlashWords = 0;
+uint32_t simFlashFail = 0;
+uint32_t simCrcWords = 0;
+int simFailures = 0;
+int simChecks = 0;
+
+static void die(const char *why) {
+  fprintf( stderr, "sim: %s at %lluus\n", why, (unsigned long long)(now / SIM_TICKS_PER_US) );
+  exit( 2 );
+}
+
+static void watchdog(int sig) {
+  static const char msg[] = "sim: hung, still running after the watchdog\n";
+  (void)sig;
+  if ( write( 2, msg, sizeof(msg)-1 ) ) { }
+  _exit( 3 );
+}
+
+__attribute__((constructor))
+static void simInit(void) {
+  for (size_t i=0; i<sizeof(regions)/sizeof(regions[0]); i++) {
+    void *p = mmap( (void *)regions[i].base, regions[i].len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+    if ( p != (void *)regions[i].base ) {
+      fprintf( stderr, "sim: can't map %#lx\n", (unsigned long)regions[i].base );
+      exit( 2 );
+    }
+  }
+  // the reset values anything reads before writing
+  TIM2->ARR = 0xFFFF;
+  TIM21->ARR = 0xFFFF;
+  LPTIM1->ARR = 0xFFFF;
+  FLASH->PECR = FLASH_PECR_PELOCK | FLASH_PECR_PRGLOCK | FLASH_PECR_OPTLOCK;
+  CRC->INIT = 0xFFFFFFFF;
+  CRC->DR = 0xFFFFFFFF;
+  CRC->POL = 0x04C11DB7;
+  RCC->CR = RCC_CR_MSION | RCC_CR_MSIRDY;
+  LPUART1->ISR = USART_ISR_TXE | USART_ISR_TC;
+  LPUART1->TDR = TDR_EMPTY;
+  USART2->ISR = USART_ISR_TXE | USART_ISR_TC;
+  USART2->TDR = TDR_EMPTY;
+  // the board at rest: no fault, buttons up, the WPC holding the motor off, limit open
+  GPIOA->IDR = S_NFLT_Pin | EN_Pin;
+  GPIOB->IDR = DIR_Pin;
+  GPIOC->IDR = SW0_Pin | SW1_Pin;
+
+  signal( SIGALRM, watchdog );
+  alarm( WATCHDOG_S );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// interrupts
+
+static bool timAsserted(TIM_TypeDef *tim) {
+  return tim->SR & tim->DIER & 0x5F;
+}
+
+static bool dmaAsserted(int ch) {
+  uint32_t flags = (DMA1->ISR >> (4*(ch-1))) & (DMA_ISR_TCIF1 | DMA_ISR_HTIF1 | DMA_ISR_TEIF1);
+  return flags & channels[ch-1]->CCR;
+}
+
+static bool systickAsserted(void) { return systick.pending; }
+static bool flashAsserted(void) {
+  uint32_t sr = FLASH->SR, pecr = FLASH->PECR;
+  uint32_t errors = FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR | FLASH_SR_NOTZEROERR | FLASH_SR_FWWERR;
+  return ((sr & FLASH_SR_EOP) && (pecr & FLASH_PECR_EOPIE)) || ((sr & errors) && (pecr & FLASH_PECR_ERRIE));
+}
+static bool exti01Asserted(void) { return EXTI->PR & EXTI->IMR & 0x0003; }
+static bool exti415Asserted(void) { return EXTI->PR & EXTI->IMR & 0xFFF0; }
+static bool dma23Asserted(void) { return dmaAsserted( 2 ) || dmaAsserted( 3 ); }
+static bool dma45Asserted(void) { return dmaAsserted( 4 ) || dmaAsserted( 5 ); }
+static bool lptimAsserted(void) { return LPTIM1->ISR & LPTIM1->IER; }
+static bool tim2Asserted(void) { return timAsserted( TIM2 ); }
+static bool tim21Asserted(void) { return timAsserted( TIM21 ); }
+
+// in exception number order, which breaks ties between equal priorities
+static const struct {
+    IRQn_Type irq;
+    void (*handler)(void);
+    bool (*asserted)(void);
+} irqs[] = {
+    { SysTick_IRQn, SysTick_Handler, systickAsserted },
+    { FLASH_IRQn, FLASH_IRQHandler, flashAsserted },
+    { EXTI0_1_IRQn, EXTI0_1_IRQHandler, exti01Asserted },
+    { EXTI4_15_IRQn, EXTI4_15_IRQHandler, exti415Asserted },
+    { DMA1_Channel2_3_IRQn, DMA1_Channel2_3_IRQHandler, dma23Asserted },
+    { DMA1_Channel4_5_IRQn, DMA1_Channel4_5_IRQHandler, dma45Asserted },
+    { LPTIM1_IRQn, LPTIM1_IRQHandler, lptimAsserted },
+    { TIM2_IRQn, TIM2_IRQHandler, tim2Asserted },
+    { TIM21_IRQn, TIM21_IRQHandler, tim21Asserted }
+};
+#define IRQ_COUNT                  (int)(sizeof(irqs)/sizeof(irqs[0]))
+
+// the asserted interrupt that would preempt what's running, -1 for none
+static int highest(void) {
+  int best = -1;
+  uint32_t level = running;
+  for (int i=0; i<IRQ_COUNT; i++) {
+    if ( irqs[i].asserted() ) {
+      uint32_t prio = NVIC_GetPriority( irqs[i].irq );
+      if ( prio < level ) {
+        best = i;
+        level = prio;
+      }
+    }
+  }
+  return best;
+}
+
+// VAL counting down to the next reload and PENDSTSET while the handler waits, in the memory
+// cycles() reads them from straight, kept up whenever the time or the pending changes
+static void systickShow(void) {
+  if ( systick.on ) {
+    SysTick->VAL = (uint32_t)(systick.next - now) * SYSTICK_PER_TICK - 1;
+  }
+  if ( systick.pending ) {
+    SCB->ICSR |= SCB_ICSR_PENDSTSET_Msk;
+  } else {
+    SCB->ICSR &= ~SCB_ICSR_PENDSTSET_Msk;
+  }
+}
+
+static void dispatch(void) {
+  systickShow();
+  while ( !primask ) {
+    int i = highest();
+    if ( i < 0 ) {
+      return;
+    }
+    if ( !irqs[i].handler ) {
+      die( "interrupt with no handler" );
+    }
+    uint32_t was = running;
+    running = NVIC_GetPriority( irqs[i].irq );
+    if ( irqs[i].irq == SysTick_IRQn ) {
+      systick.pending = false;
+      systickShow();
+    }
+    irqs[i].handler();
+    if ( irqs[i].irq == FLASH_IRQn ) {
+      // the handler clears SR with a plain store, which only wrote the bits back
+      FLASH->SR = 0;
+    }
+    running = was;
+  }
+}
+
+void simDisableIrq(void) {
+  primask = true;
+}
+
+// from thread code whatever got held off is taken now, the sim itself carries on first
+static void settle(void) {
+  if ( !in_sim ) {
+    dispatch();
+  }
+}
+
+void simEnableIrq(void) {
+  primask = false;
+  settle();
+}
+
+uint32_t simGetPrimask(void) {
+  return primask;
+}
+
+void simSetPrimask(uint32_t m) {
+  primask = m & 1;
+  settle();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// the plant
+
+static void simPinQuiet(GPIO_TypeDef *port, uint32_t pin, bool high);
+
+static void limitCheck(void) {
+  if ( limit_on ) {
+    bool hit = carriage <= limit_at;
+    if ( hit != ((LIMIT_GPIO_Port->IDR & LIMIT_Pin) != 0) ) {
+      simPinQuiet( LIMIT_GPIO_Port, LIMIT_Pin, hit );
+    }
+  }
+}
+
+// held in reset the indexer goes back to its home entry, and the rotor with it to the
+// nearest place that entry holds it, within two full steps either way
+static void phaseHome(void) {
+  carriage += ((PHASE_HOME - phase + 64) & 127) - 64;
+  phase = PHASE_HOME;
+}
+
+// one rising edge on S_STEP, the indexer goes to the next entry its mode pins allow
+static void stepPulse(void) {
+  pulses++;
+  if ( simStep ) {
+    simStep();
+  }
+  uint32_t odr = GPIOA->ODR;
+  if ( !(odr & S_NRST_Pin) || (odr & S_NEN_Pin) ) {
+    return;
+  }
+  int size = (odr >> 5) & 7;
+  int u = USTEPS_PER_STEP >> (size > 5 ? 5 : size);
+  int off = (phase - PHASE_HOME) & (u-1);
+  int step;
+  if ( !(odr & S_DIR_Pin) ) {
+    step = u - off;
+  } else {
+    step = -(off ? off : u);
+  }
+  phase = (phase + step) & 127;
+  carriage += step;
+  limitCheck();
+}
+
+static void outputs(GPIO_TypeDef *port, uint32_t was) {
+  uint32_t odr = port->ODR;
+  uint32_t changed = was ^ odr;
+  if ( !changed ) {
+    return;
+  }
+  if ( port == S_NRST_GPIO_Port && (changed & S_NRST_Pin) && !(odr & S_NRST_Pin) ) {
+    phaseHome();
+  }
+  if ( simOutput ) {
+    simOutput( port, changed, odr );
+  }
+}
+
+int32_t simCarriage(void) {
+  return carriage;
+}
+
+uint32_t simPulses(void) {
+  return pulses;
+}
+
+void simLimit(int32_t at) {
+  in_sim++;
+  limit_on = true;
+  limit_at = at;
+  limitCheck();
+  in_sim--;
+  settle();
+}
+
+void simSlip(int32_t usteps) {
+  in_sim++;
+  carriage += usteps;
+  limitCheck();
+  in_sim--;
+  settle();
+}
+
+void simPlant(sim_plant_t *plant) {
+  memcpy( plant->eeprom, (void *)DATA_EEPROM_BASE, sizeof(plant->eeprom) );
+  plant->carriage = carriage;
+  plant->phase = phase;
+  plant->limit_on = limit_on;
+  plant->limit_at = limit_at;
+}
+
+void simPowerUp(const sim_plant_t *plant) {
+  in_sim++;
+  memcpy( (void *)DATA_EEPROM_BASE, plant->eeprom, sizeof(plant->eeprom) );
+  carriage = plant->carriage;
+  phase = plant->phase;
+  phaseHome();
+  limit_on = plant->limit_on;
+  limit_at = plant->limit_at;
+  limitCheck();
+  in_sim--;
+  // its own time from here, however long it waited
+  alarm( WATCHDOG_S );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// peripherals
+
+static uint32_t load(uintptr_t a, int size) {
+  switch ( size ) {
+    case 1: return *(volatile uint8_t *)a;
+    case 2: return *(volatile uint16_t *)a;
+    default: return *(volatile uint32_t *)a;
+  }
+}
+
+static void store(uintptr_t a, int size, uint32_t v) {
+  switch ( size ) {
+    case 1: *(volatile uint8_t *)a = v; break;
+    case 2: *(volatile uint16_t *)a = v; break;
+    default: *(volatile uint32_t *)a = v; break;
+  }
+}
+
+// one request on channel ch, one element across
+static void dmaRequest(int ch) {
+  DMA_Channel_TypeDef *c = channels[ch-1];
+  uint32_t ccr = c->CCR;
+  uint32_t left = c->CNDTR & 0xFFFF;
+  if ( !(ccr & DMA_CCR_EN) || left == 0 ) {
+    return;
+  }
+  int msize = 1 << ((ccr & DMA_CCR_MSIZE) >> DMA_CCR_MSIZE_Pos);
+  int psize = 1 << ((ccr & DMA_CCR_PSIZE) >> DMA_CCR_PSIZE_Pos);
+  uintptr_t mem = c->CMAR + ((ccr & DMA_CCR_MINC) ? dma[ch-1].idx * msize : 0);
+  uintptr_t per = c->CPAR + ((ccr & DMA_CCR_PINC) ? dma[ch-1].idx * psize : 0);
+  // the registers are all whole words, a narrower access on the APB lands on all of it
+  if ( ccr & DMA_CCR_DIR ) {
+    store( per, 4, load( mem, msize ) & (0xFFFFFFFF >> (32 - 8*psize)) );
+  } else {
+    store( mem, msize, load( per, 4 ) & (0xFFFFFFFF >> (32 - 8*psize)) );
+  }
+  dma[ch-1].idx++;
+  left--;
+  uint32_t flags = 0;
+  if ( left == dma[ch-1].len / 2 ) {
+    flags |= DMA_ISR_HTIF1 | DMA_ISR_GIF1;
+  }
+  if ( left == 0 ) {
+    flags |= DMA_ISR_TCIF1 | DMA_ISR_GIF1;
+    if ( ccr & DMA_CCR_CIRC ) {
+      left = dma[ch-1].len;
+      dma[ch-1].idx = 0;
+    }
+  }
+  c->CNDTR = left;
+  DMA1->ISR |= flags << (4*(ch-1));
+}
+
+static void dmaEnabled(int ch) {
+  dma[ch-1].len = channels[ch-1]->CNDTR & 0xFFFF;
+  dma[ch-1].idx = 0;
+  if ( ch == 4 ) {
+    trace_on = true;
+    trace_next = now + UART_BYTE_TICKS;
+  }
+}
+
+// a pulse on TIM2 CH3, counted by TIM21 off TRGO
+static void tim2Pulse(void) {
+  if ( TIM21->CR1 & TIM_CR1_CEN ) {
+    uint32_t cnt = TIM21->CNT + 1;
+    if ( cnt > (TIM21->ARR & 0xFFFF) ) {
+      cnt = 0;
+      TIM21->SR |= TIM_SR_UIF;
+    }
+    TIM21->CNT = cnt;
+    if ( cnt == (TIM21->CCR1 & 0xFFFF) ) {
+      TIM21->SR |= TIM_SR_CC1IF;
+    }
+    if ( cnt == (TIM21->CCR2 & 0xFFFF) ) {
+      TIM21->SR |= TIM_SR_CC2IF;
+    }
+  }
+  stepPulse();
+}
+
+static void tim2Update(void) {
+  tim2.arr = TIM2->ARR & 0xFFFF;
+  tim2.ccr3 = TIM2->CCR3 & 0xFFFF;
+  TIM2->SR |= TIM_SR_UIF;
+  if ( tim2.ccr3 ) {
+    tim2Pulse();
+  }
+  if ( TIM2->DIER & TIM_DIER_UDE ) {
+    dmaRequest( 2 );
+  }
+  tim2.next = now + tim2.arr + 1;
+}
+
+static void tim2Enabled(void) {
+  tim2.on = true;
+  if ( tim2.ccr3 ) {
+    tim2Pulse();
+  }
+  tim2.next = now + tim2.arr + 1;
+}
+
+static void lptimStarted(void) {
+  lptim.on = true;
+  lptim.base = now;
+  lptim.next = now + SIM_US(LPTIM1->ARR & 0xFFFF);
+}
+
+static void flashStarted(void) {
+  flash.busy = true;
+  flash.at = now + FLASH_WORD_TICKS;
+  memcpy( flash.before, (void *)DATA_EEPROM_BASE, sizeof(flash.before) );
+}
+
+static void flashFinished(void) {
+  flash.busy = false;
+  simFlashWords++;
+  if ( simFlashWords == simFlashFail ) {
+    memcpy( (void *)DATA_EEPROM_BASE, flash.before, sizeof(flash.before) );
+    FLASH->SR = FLASH_SR_WRPERR;
+  } else {
+    FLASH->SR = FLASH_SR_EOP;
+  }
+  if ( simFlashDone ) {
+    simFlashDone();
+  }
+}
+
+static uint32_t crc32Word(uint32_t crc, uint32_t word) {
+  crc ^= word;
+  for (int i=0; i<32; i++) {
+    crc = (crc & 0x80000000) ? (crc << 1) ^ CRC->POL : crc << 1;
+  }
+  return crc;
+}
+
+// what the LPUART had to send, taken when the firmware looks whether it can send more
+static void uartTake(void) {
+  if ( LPUART1->TDR != TDR_EMPTY ) {
+    if ( uart_tx_len < CAPTURE_LEN ) {
+      uart_tx[uart_tx_len++] = LPUART1->TDR;
+    }
+    LPUART1->TDR = TDR_EMPTY;
+  }
+}
+
+static void traceByte(void) {
+  dmaRequest( 4 );
+  if ( USART2->TDR != TDR_EMPTY ) {
+    if ( trace_tx_len < CAPTURE_LEN ) {
+      trace_tx[trace_tx_len++] = USART2->TDR;
+    }
+    USART2->TDR = TDR_EMPTY;
+  }
+  if ( (DMA1_Channel4->CNDTR & 0xFFFF) && (DMA1_Channel4->CCR & DMA_CCR_EN) ) {
+    trace_next += UART_BYTE_TICKS;
+  } else {
+    trace_on = false;
+  }
+}
+
+static void gpioWritten(volatile uint32_t *r, uint32_t value) {
+  GPIO_TypeDef *port = (GPIO_TypeDef *)((uintptr_t)r & ~(uintptr_t)0x3FF);
+  uint32_t was = port->ODR;
+  if ( r == &port->BSRR ) {
+    port->ODR = (was & ~(value >> 16)) | (value & 0xFFFF);
+  } else if ( r == &port->BRR ) {
+    port->ODR = was & ~value;
+  } else {
+    *r = value;
+  }
+  outputs( port, was );
+}
+
+void simWrite(volatile void *reg, size_t size, uint32_t value) {
+  uintptr_t a = (uintptr_t)reg;
+  if ( size != 4 ) {
+    store( a, size, value );
+    return;
+  }
+  volatile uint32_t *r = reg;
+  uint32_t was = *r;
+  in_sim++;
+  if ( r == &TIM2->SR || r == &TIM21->SR ) {
+    *r = was & value;
+  } else if ( r == &TIM2->EGR ) {
+    if ( value & TIM_EGR_UG ) {
+      tim2.arr = TIM2->ARR & 0xFFFF;
+      tim2.ccr3 = TIM2->CCR3 & 0xFFFF;
+      TIM2->CNT = 0;
+    }
+  } else if ( r == &TIM21->EGR ) {
+    TIM21->SR |= value & (TIM_EGR_CC1G | TIM_EGR_CC2G);
+    if ( value & TIM_EGR_UG ) {
+      TIM21->CNT = 0;
+    }
+  } else if ( r == &TIM2->CR1 ) {
+    *r = value;
+    if ( !(was & TIM_CR1_CEN) && (value & TIM_CR1_CEN) ) {
+      tim2Enabled();
+    } else if ( !(value & TIM_CR1_CEN) ) {
+      tim2.on = false;
+    }
+  } else if ( r == &DMA1->IFCR ) {
+    DMA1->ISR &= ~value;
+  } else if ( a >= DMA1_Channel1_BASE && a < DMA1_Channel5_BASE + 0x14 && (a - DMA1_Channel1_BASE) % 0x14 == 0 ) {
+    *r = value;
+    if ( !(was & DMA_CCR_EN) && (value & DMA_CCR_EN) ) {
+      dmaEnabled( (a - DMA1_Channel1_BASE) / 0x14 + 1 );
+    }
+  } else if ( r == &EXTI->PR ) {
+    EXTI->PR &= ~value;
+  } else if ( r == &LPTIM1->ICR ) {
+    LPTIM1->ISR &= ~value;
+  } else if ( r == &LPTIM1->CR ) {
+    *r = value & ~(LPTIM_CR_CNTSTRT | LPTIM_CR_SNGSTRT);
+    if ( !(value & LPTIM_CR_ENABLE) ) {
+      lptim.on = false;
+    } else if ( value & LPTIM_CR_CNTSTRT ) {
+      lptimStarted();
+    }
+  } else if ( r == &RCC->CR ) {
+    value &= ~(RCC_CR_HSIRDY | RCC_CR_MSIRDY | RCC_CR_PLLRDY);
+    *r = value | ((value & RCC_CR_HSION) ? RCC_CR_HSIRDY : 0) | ((value & RCC_CR_MSION) ? RCC_CR_MSIRDY : 0) |
+         ((value & RCC_CR_PLLON) ? RCC_CR_PLLRDY : 0);
+  } else if ( r == &RCC->CFGR ) {
+    *r = (value & ~RCC_CFGR_SWS) | ((value & RCC_CFGR_SW) << RCC_CFGR_SWS_Pos);
+  } else if ( r == &CRC->CR ) {
+    *r = value & ~CRC_CR_RESET;
+    if ( value & CRC_CR_RESET ) {
+      CRC->DR = CRC->INIT;
+    }
+  } else if ( r == &CRC->DR ) {
+    *r = crc32Word( was, value );
+    simCrcWords++;
+  } else if ( r == &FLASH->PECR ) {
+    *r = value;
+    // the store that follows is what really starts it, but that's plain memory here
+    if ( (value & FLASH_PECR_EOPIE) && !flash.busy ) {
+      flashStarted();
+    }
+  } else if ( a >= IOPPERIPH_BASE && a < IOPPERIPH_BASE + 0x2000 ) {
+    gpioWritten( r, value );
+  } else {
+    *r = value;
+  }
+  in_sim--;
+  settle();
+}
+
+static void advance(uint64_t until);
+
+uint32_t simRead(const volatile void *reg, size_t size) {
+  uintptr_t a = (uintptr_t)reg;
+  const volatile uint32_t *r = reg;
+  if ( r == &LPTIM1->CNT ) {
+    return lptim.on ? ((now - lptim.base) / SIM_TICKS_PER_US) % ((LPTIM1->ARR & 0xFFFF) + 1) : 0;
+  }
+  if ( r == &LPTIM1->ISR && running == THREAD && !in_sim ) {
+    // the loop is polling the time, let some go by
+    advance( now + SIM_TICKS_PER_US );
+  }
+  if ( r == &LPUART1->ISR ) {
+    uartTake();
+  }
+  return load( a, size );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// time
+
+static void systickCheck(void) {
+  uint32_t ctrl = SysTick->CTRL;
+  bool on = (ctrl & SysTick_CTRL_ENABLE_Msk) && (ctrl & SysTick_CTRL_TICKINT_Msk);
+  if ( on && !systick.on ) {
+    systick.next = now + (SysTick->LOAD + 1) / SYSTICK_PER_TICK;
+  }
+  systick.on = on;
+}
+
+static uint64_t nextEvent(void) {
+  uint64_t t = UINT64_MAX;
+  systickCheck();
+  if ( script_len && script[0].at < t ) t = script[0].at;
+  if ( tim2.on && tim2.next < t ) t = tim2.next;
+  if ( systick.on && systick.next < t ) t = systick.next;
+  if ( lptim.on && lptim.next < t ) t = lptim.next;
+  if ( flash.busy && flash.at < t ) t = flash.at;
+  if ( trace_on && trace_next < t ) t = trace_next;
+  return t;
+}
+
+static void runScript(void) {
+  void (*fn)(void) = script[0].fn;
+  script_len--;
+  memmove( &script[0], &script[1], script_len * sizeof(script[0]) );
+  fn();
+}
+
+// one thing due at now
+static void fire(void) {
+  in_sim++;
+  if ( tim2.on && tim2.next == now ) {
+    tim2Update();
+  } else if ( systick.on && systick.next == now ) {
+    systick.pending = true;
+    systick.next += (SysTick->LOAD + 1) / SYSTICK_PER_TICK;
+  } else if ( lptim.on && lptim.next == now ) {
+    LPTIM1->ISR |= LPTIM_ISR_ARRM;
+    lptim.next += SIM_US((LPTIM1->ARR & 0xFFFF) + 1);
+  } else if ( flash.busy && flash.at == now ) {
+    flashFinished();
+  } else if ( trace_on && trace_next == now ) {
+    traceByte();
+  } else if ( script_len && script[0].at == now ) {
+    runScript();
+  }
+  in_sim--;
+}
+
+static void advance(uint64_t until) {
+  for (;;) {
+    uint64_t t = nextEvent();
+    if ( t > until ) {
+      break;
+    }
+    if ( t > now ) {
+      now = t;
+    }
+    fire();
+    dispatch();
+  }
+  if ( until > now ) {
+    now = until;
+  }
+  dispatch();
+}
+
+uint64_t simTime(void) {
+  return now;
+}
+
+void simRun(uint32_t us) {
+  advance( now + SIM_US(us) );
+}
+
+void simWait(void) {
+  uint64_t t = nextEvent();
+  if ( t == UINT64_MAX ) {
+    die( "waiting with nothing left to happen" );
+  }
+  advance( t );
+}
+
+void simAt(uint64_t at, void (*fn)(void)) {
+  if ( script_len == SCRIPT_LEN ) {
+    die( "script full" );
+  }
+  int i = script_len++;
+  while ( i > 0 && script[i-1].at > at ) {
+    script[i] = script[i-1];
+    i--;
+  }
+  script[i].at = at;
+  script[i].fn = fn;
+}
+
+// stop mode, every clock but the outside world's holds still until something wakes us
+static void stop(void) {
+  while ( highest() < 0 ) {
+    if ( !script_len ) {
+      die( "stopped with nothing left to wake it" );
+    }
+    uint64_t dt = script[0].at > now ? script[0].at - now : 0;
+    tim2.next += dt;
+    systick.next += dt;
+    lptim.base += dt;
+    lptim.next += dt;
+    flash.at += dt;
+    trace_next += dt;
+    now += dt;
+    systickShow();
+    in_sim++;
+    runScript();
+    in_sim--;
+  }
+}
+
+void simWfi(void) {
+  if ( SCB->SCR & SCB_SCR_SLEEPDEEP_Msk ) {
+    stop();
+    return;
+  }
+  while ( highest() < 0 ) {
+    simWait();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// the outside world
+
+static void simPinQuiet(GPIO_TypeDef *port, uint32_t pin, bool high) {
+  uint32_t was = port->IDR;
+  uint32_t idr = high ? (was | pin) : (was & ~pin);
+  uint32_t changed = was ^ idr;
+  port->IDR = idr;
+  uint32_t index = ((uintptr_t)port - IOPPERIPH_BASE) / 0x400;
+  for (int line=0; line<16; line++) {
+    uint32_t bit = 1 << line;
+    if ( !(changed & bit) || ((SYSCFG->EXTICR[line/4] >> (4*(line%4))) & 0xF) != index ) {
+      continue;
+    }
+    if ( (idr & bit) ? (EXTI->RTSR & bit) : (EXTI->FTSR & bit) ) {
+      EXTI->PR |= bit;
+    }
+  }
+}
+
+void simPin(GPIO_TypeDef *port, uint32_t pin, bool high) {
+  simPinQuiet( port, pin, high );
+  settle();
+}
+
+void simUartRx(const uint8_t *data, size_t len) {
+  in_sim++;
+  for (size_t i=0; i<len; i++) {
+    LPUART1->RDR = data[i];
+    if ( LPUART1->CR3 & USART_CR3_DMAR ) {
+      dmaRequest( 3 );
+    }
+  }
+  in_sim--;
+  settle();
+}
+
+static size_t takeCapture(uint8_t *capture, size_t *len, uint8_t *data, size_t max) {
+  size_t n = (*len < max) ? *len : max;
+  memcpy( data, capture, n );
+  memmove( capture, capture + n, *len - n );
+  *len -= n;
+  return n;
+}
+
+size_t simUartTx(uint8_t *data, size_t max) {
+  uartTake();
+  return takeCapture( uart_tx, &uart_tx_len, data, max );
+}
+
+size_t simTraceTx(uint8_t *data, size_t max) {
+  return takeCapture( trace_tx, &trace_tx_len, data, max );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// the handlers a test doesn't link the firmware's own of
+
+#define UNEXPECTED(fn) \
+  __attribute__((weak)) void fn(void) { simFail( __FILE__, __LINE__, "unexpected %s", #fn ); }
+
+UNEXPECTED(mySysTick_Handler)
+UNEXPECTED(myIRQ_0_1)
+UNEXPECTED(myIRQ_4_15)
+UNEXPECTED(myIRQ_EN_DIR)
+UNEXPECTED(myIRQ_LPTIM1)
+UNEXPECTED(myIRQ_TIM2)
+UNEXPECTED(myIRQ_DMA_2_3)
+UNEXPECTED(myIRQ_DMA_4_5)
+UNEXPECTED(myIRQ_TIM21_UP)
+UNEXPECTED(myIRQ_TIM21_CC1)
+UNEXPECTED(myIRQ_TIM21_CC2)
+
+__attribute__((weak)) void myIRQ_FLASH(uint32_t errors) {
+  simFail( __FILE__, __LINE__, "unexpected myIRQ_FLASH %#x", (unsigned)errors );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// checks
+
+void simFail(const char *file, int line, const char *fmt, ...) {
+  va_list ap;
+  simFailures++;
+  fprintf( stderr, "%s:%d: at %lluus: ", file, line, (unsigned long long)(now / SIM_TICKS_PER_US) );
+  va_start( ap, fmt );
+  vfprintf( stderr, fmt, ap );
+  va_end( ap );
+  fputc( '\n', stderr );
+}
+
+int simDone(const char *name) {
+  if ( simFailures ) {
+    printf( "%s: %d of %d checks failed\n", name, simFailures, simChecks );
+    return 1;
+  }
+  printf( "%s: %d checks passed\n", name, simChecks );
+  return 0;
+}
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// sim.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SIM_H
+#define __SIM_H
+
+// forced ahead of every source in the host build (-include sim.h). the device header comes
+// in first so the LL headers included after it pick up the register access macros and the
+// intrinsics below, which go through sim.c instead of straight to memory. the peripherals
+// are mapped at their own addresses, so anything that still touches a register directly
+// reads and writes plain memory and sim.c keeps that memory looking like the hardware
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "stm32l0xx.h"
+
+void simWrite(volatile void *reg, size_t size, uint32_t value);
+uint32_t simRead(const volatile void *reg, size_t size);
+
+#undef SET_BIT
+#undef CLEAR_BIT
+#undef READ_BIT
+#undef CLEAR_REG
+#undef WRITE_REG
+#undef READ_REG
+#define WRITE_REG(REG, VAL)        simWrite( &(REG), sizeof(REG), (uint32_t)(VAL) )
+#define READ_REG(REG)              simRead( &(REG), sizeof(REG) )
+#define SET_BIT(REG, BIT)          WRITE_REG( REG, READ_REG(REG) | (BIT) )
+#define CLEAR_BIT(REG, BIT)        WRITE_REG( REG, READ_REG(REG) & ~(BIT) )
+#define READ_BIT(REG, BIT)         ( READ_REG(REG) & (BIT) )
+#define CLEAR_REG(REG)             WRITE_REG( REG, 0 )
+
+void simDisableIrq(void);
+void simEnableIrq(void);
+uint32_t simGetPrimask(void);
+void simSetPrimask(uint32_t primask);
+void simWfi(void);
+
+#define __disable_irq()            simDisableIrq()
+#define __enable_irq()             simEnableIrq()
+#define __get_PRIMASK()            simGetPrimask()
+#define __set_PRIMASK(m)           simSetPrimask(m)
+#define __WFI()                    simWfi()
+#define __DSB()                    do { } while (0)
+#define __ISB()                    do { } while (0)
+#define __DMB()                    do { } while (0)
+
+// time is counted in step timer ticks, 1/4us, so a pulse lands exactly where TIM2 puts it
+#define SIM_TICKS_PER_US           4
+#define SIM_US(us)                 ((uint64_t)(us) * SIM_TICKS_PER_US)
+
+uint64_t simTime(void);
+// run the hardware and the interrupts it raises for us, or to the next thing that happens
+void simRun(uint32_t us);
+void simWait(void);
+// fn runs at the absolute time at, between interrupts, as if the outside world did it
+void simAt(uint64_t at, void (*fn)(void));
+
+// an input pin as the board drives it, edges go to the EXTI the way SYSCFG routes them
+void simPin(GPIO_TypeDef *port, uint32_t pin, bool high);
+// called for every output pin that changes, with the port's new ODR
+extern void (*simOutput)(GPIO_TypeDef *port, uint32_t changed, uint32_t odr);
+
+// the carriage, in 1/32 steps, moved by each pulse the drv8825 takes. the indexer's phase
+// is modelled so a step size change off its grid comes out short like the real one, and a
+// reset pulls the rotor round to the home entry
+int32_t simCarriage(void);
+uint32_t simPulses(void);
+// called for every pulse TIM2 puts out on S_STEP, before the drv8825 takes it
+extern void (*simStep)(void);
+// the limit switch closes with the carriage at or below at
+void simLimit(int32_t at);
+// the carriage moves by usteps with the indexer left where it is, steps lost to a stall
+void simSlip(int32_t usteps);
+
+// what's left once the power goes, the data eeprom and where the carriage stopped
+typedef struct {
+    uint8_t eeprom[DATA_EEPROM_END - DATA_EEPROM_BASE + 1];
+    int32_t carriage;
+    int phase;
+    bool limit_on;
+    int32_t limit_at;
+} sim_plant_t;
+void simPlant(sim_plant_t *plant);
+// a fresh process picks up from there before the firmware has run. the board holds nRESET
+// low through a reset, so the indexer comes up at home and pulls the rotor round to it
+void simPowerUp(const sim_plant_t *plant);
+
+// every word programmed into the data eeprom calls this before its interrupt, and the
+// fail'th one from the start fails and leaves the old word, 0 for never
+extern void (*simFlashDone)(void);
+extern uint32_t simFlashWords;
+extern uint32_t simFlashFail;
+// words fed to the CRC unit
+extern uint32_t simCrcWords;
+
+// LPUART1 in through its rx dma, and what's been sent out since the last call
+void simUartRx(const uint8_t *data, size_t len);
+size_t simUartTx(uint8_t *data, size_t max);
+// USART2 out through its tx dma
+size_t simTraceTx(uint8_t *data, size_t max);
+
+// checks for the tests, a failure is counted and reported, the test carries on
+extern int simFailures;
+extern int simChecks;
+#define CHECK(cond, ...)           do { simChecks++; if ( !(cond) ) simFail( __FILE__, __LINE__, __VA_ARGS__ ); } while (0)
+void simFail(const char *file, int line, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+// prints the summary, the exit status for main()
+int simDone(const char *name);
+
+#endif // __SIM_H
@@ -0,0 +1,332 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_eeprom.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+// in with its statics, so a reboot can forget what it knew and find it again from the image
+#include "../Core/Src/eeprom.c"
+
+static uint8_t *const image = (uint8_t *)DATA_EEPROM_BASE;
+
+// the words in the order they went in, and the image a reset right after one of them leaves
+static uint32_t programmed[64];
+static uint32_t programmed_len = 0;
+static uint32_t torn_at = 0;
+static uint8_t torn[EE_SIZE];
+// times each word has been programmed
+static uint32_t wear[EE_SIZE / 4];
+
+static void flashDone(void) {
+  if ( programmed_len < 64 ) {
+    programmed[programmed_len++] = ee_queue[ee_tail].offset;
+  }
+  wear[ ee_queue[ee_tail].offset / 4 ]++;
+  if ( simFlashWords == torn_at ) {
+    memcpy( torn, image, EE_SIZE );
+  }
+}
+
+static void settle(void) {
+  while ( eeBusy() ) {
+    simWait();
+  }
+}
+
+static void reboot(void) {
+  config_seq = 0;
+  config_slot = -1;
+  resume_seq = 0;
+  resume_slot = RESUME_COUNT - 1;
+}
+
+static void startCount(void) {
+  programmed_len = 0;
+  simFlashWords = 0;
+  simFlashFail = 0;
+  torn_at = 0;
+}
+
+// CRC-32/MPEG-2 a byte at a time, the word fed to the unit is its bytes most significant first
+static uint32_t mpeg2(uint32_t crc, const uint8_t *p, size_t len) {
+  while ( len-- ) {
+    crc ^= (uint32_t)*p++ << 24;
+    for (int i=0; i<8; i++) {
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static void testCrc(void) {
+  CHECK( mpeg2( 0xFFFFFFFF, (const uint8_t *)"123456789", 9 ) == 0x0376E6E7, "crc: reference is off" );
+  static const config_t c = { -12, 100, 1200, 8000, { { 1, -2 }, { 0x7FFFFFFF, (int32_t)0x80000000 } } };
+  uint32_t seq = 0xA5A5F00D;
+  uint8_t bytes[4 * (CONFIG_WORDS + 1)];
+  const int32_t *words = (const int32_t *)&c;
+  for (unsigned i=0; i<=CONFIG_WORDS; i++) {
+    uint32_t w = i ? (uint32_t)words[i-1] : seq;
+    bytes[4*i] = w >> 24;
+    bytes[4*i+1] = w >> 16;
+    bytes[4*i+2] = w >> 8;
+    bytes[4*i+3] = w;
+  }
+  CHECK( configCrc( seq, words ) == mpeg2( 0xFFFFFFFF, bytes, sizeof(bytes) ), "crc: %08x",
+         (unsigned)configCrc( seq, words ) );
+}
+
+// words go in the order they were queued, one at a time off the interrupt, and a word
+// already holding its value isn't written again
+static void testQueue(void) {
+  startCount();
+  for (int i=0; i<EE_QUEUE_LEN-1; i++) {
+    eeWrite( EE_CONFIG + 4*((i*7) % 20), 1000 + i );
+  }
+  CHECK( eeBusy(), "queue: not busy" );
+  settle();
+  CHECK( programmed_len == EE_QUEUE_LEN-1, "queue: %u words", (unsigned)programmed_len );
+  for (int i=0; i<EE_QUEUE_LEN-1 && i<(int)programmed_len; i++) {
+    CHECK( programmed[i] == (uint32_t)(EE_CONFIG + 4*((i*7) % 20)), "queue: word %d went to %u", i,
+           (unsigned)programmed[i] );
+  }
+  for (int i=0; i<EE_QUEUE_LEN-1; i++) {
+    int32_t v;
+    eeRead( EE_CONFIG + 4*((i*7) % 20), &v );
+    CHECK( v == 1000 + i, "queue: word %d reads %d", i, (int)v );
+  }
+  CHECK( (FLASH->PECR & (FLASH_PECR_EOPIE | FLASH_PECR_ERRIE | FLASH_PECR_PRGLOCK)) == FLASH_PECR_PRGLOCK,
+         "queue: left PECR %08x", (unsigned)FLASH->PECR );
+
+  startCount();
+  eeWrite( EE_CONFIG, 1000 );
+  CHECK( !eeBusy() && programmed_len == 0, "queue: rewrote the same value" );
+  memset( image, 0, EE_SIZE );
+}
+
+static config_t configN(int n) {
+  config_t c = { n - 20, 100 + n, 1200 - n, 8000 + 10*n, { { 3*n, -4*n }, { 5*n, n*n } } };
+  return c;
+}
+
+// each save goes to the next slot round and a reboot finds the newest
+static void testConfig(void) {
+  reboot();
+  config_t c = configN( 99 );
+  CHECK( !configLoad( &c ) && c.speed == configN( 99 ).speed, "config: blank eeprom loaded" );
+  for (int n=0; n<3*(int)SLOT_COUNT; n++) {
+    config_t want = configN( n );
+    startCount();
+    configSave( &want );
+    settle();
+    CHECK( !eeError(), "config %d: error", n );
+    CHECK( programmed_len <= SLOT_WORDS, "config %d: %u words", n, (unsigned)programmed_len );
+    reboot();
+    config_t got;
+    memset( &got, 0, sizeof(got) );
+    CHECK( configLoad( &got ) && memcmp( &got, &want, sizeof(got) ) == 0, "config %d: didn't load", n );
+    CHECK( config_slot == n % (int)SLOT_COUNT, "config %d: slot %d", n, config_slot );
+  }
+}
+
+// a reset after any word of a save leaves the old config newest, until the crc is in
+static void testTornConfig(void) {
+  config_t old = configN( 40 );
+  configSave( &old );
+  settle();
+  for (uint32_t w=1; w<=SLOT_WORDS; w++) {
+    config_t want = configN( 50 + w );
+    startCount();
+    torn_at = w;
+    configSave( &want );
+    settle();
+    uint8_t saved[EE_SIZE];
+    memcpy( saved, image, EE_SIZE );
+    memcpy( image, torn, EE_SIZE );
+    reboot();
+    config_t got;
+    CHECK( configLoad( &got ), "torn at %u: nothing loaded", (unsigned)w );
+    const config_t *expect = ( w == SLOT_WORDS ) ? &want : &old;
+    CHECK( memcmp( &got, expect, sizeof(got) ) == 0, "torn at %u: loaded speed %u", (unsigned)w,
+           (unsigned)got.speed );
+    // back to the whole save for the next round
+    memcpy( image, saved, EE_SIZE );
+    reboot();
+    configLoad( &old );
+  }
+}
+
+// a word that won't program is latched until the next save begins, and the crc keeps the
+// torn record from loading
+static void testError(void) {
+  config_t old = configN( 70 );
+  configSave( &old );
+  settle();
+  config_t want = configN( 71 );
+  startCount();
+  simFlashFail = 3;
+  configSave( &want );
+  settle();
+  CHECK( eeError(), "error: not latched" );
+  CHECK( (FLASH->SR & (FLASH_SR_WRPERR | FLASH_SR_EOP)) == 0, "error: SR left %08x", (unsigned)FLASH->SR );
+  reboot();
+  config_t got;
+  CHECK( configLoad( &got ) && memcmp( &got, &old, sizeof(got) ) == 0, "error: loaded the failed save" );
+
+  startCount();
+  configSave( &want );
+  CHECK( !eeError(), "error: still latched once the next save began" );
+  settle();
+  CHECK( !eeError(), "error: retry failed" );
+  reboot();
+  CHECK( configLoad( &got ) && memcmp( &got, &want, sizeof(got) ) == 0, "error: retry didn't load" );
+}
+
+// the newest resume record reads back until it's cleared, through reboots and round the ring
+static void testResume(void) {
+  reboot();
+  uint8_t state;
+  int32_t at;
+  for (int n=0; n<4*(int)RESUME_COUNT; n++) {
+    int32_t want = (n & 1) ? -1000 * n : 77 * n;
+    resumeWrite( n & 0xFF, want );
+    settle();
+    if ( n & 2 ) {
+      reboot();
+    }
+    CHECK( resumeRead( &state, &at ) && state == (n & 0xFF) && at == want, "resume %d: read %d", n, (int)at );
+    startCount();
+    resumeClear();
+    settle();
+    CHECK( programmed_len == 1, "resume %d: clear wrote %u words", n, (unsigned)programmed_len );
+    if ( n & 1 ) {
+      reboot();
+    }
+    CHECK( !resumeRead( &state, &at ), "resume %d: read after clear", n );
+  }
+}
+
+// a reset part way through a save finds the clear before it, never a half written record
+static void testTornResume(void) {
+  uint8_t state;
+  int32_t at;
+  for (uint32_t w=1; w<=RESUME_WORDS; w++) {
+    resumeWrite( 5, 1234 );
+    settle();
+    resumeClear();
+    settle();
+    startCount();
+    torn_at = w;
+    resumeWrite( 6, -5678 - (int32_t)w );
+    settle();
+    uint8_t saved[EE_SIZE];
+    memcpy( saved, image, EE_SIZE );
+    memcpy( image, torn, EE_SIZE );
+    reboot();
+    bool ok = resumeRead( &state, &at );
+    if ( w == RESUME_WORDS ) {
+      CHECK( ok && state == 6 && at == -5678 - (int32_t)w, "resume torn at %u: read %d", (unsigned)w, (int)at );
+    } else {
+      CHECK( !ok, "resume torn at %u: read %d", (unsigned)w, (int)at );
+    }
+    memcpy( image, saved, EE_SIZE );
+    reboot();
+    resumeRead( &state, &at );
+  }
+}
+
+// what configLoad() costs the boot, off the words the scan puts through the CRC unit. each
+// is a data eeprom load at one wait state and a store, ~8 cycles at 32MHz with the loop,
+// and a slot ~60 more for the call, the reset and the compare. estimates, the way
+// priority.h's are
+#define SCAN_WORD_CYCLES           8
+#define SCAN_SLOT_CYCLES           60
+
+// every slot once, whether it holds a record or not, the newest found on the way
+static void testScan(void) {
+  config_t got;
+  for (int full=0; full<2; full++) {
+    memset( image, 0, EE_SIZE );
+    for (int n=0; n<(full ? (int)SLOT_COUNT + 1 : 0); n++) {
+      config_t c = configN( n );
+      configSave( &c );
+      settle();
+    }
+    reboot();
+    simCrcWords = 0;
+    bool loaded = configLoad( &got );
+    uint32_t cycles = simCrcWords * SCAN_WORD_CYCLES + SLOT_COUNT * SCAN_SLOT_CYCLES;
+    printf( "configLoad %s: %u slots, %u words through the crc, ~%uus at 32MHz\n", full ? "full" : "blank",
+            (unsigned)SLOT_COUNT, (unsigned)simCrcWords, (unsigned)(cycles / 32) );
+    CHECK( simCrcWords == SLOT_COUNT * (CONFIG_WORDS + 1), "scan: %u words", (unsigned)simCrcWords );
+    CHECK( loaded == full && (!full || config_slot == 0), "scan: loaded %d from slot %d", loaded, config_slot );
+  }
+  memset( image, 0, EE_SIZE );
+}
+
+// how many saves the busiest word of a ring takes before it's past the 100k cycles the
+// datasheet has for the data eeprom, off the wear on the image after laps of real saves
+#define EE_CYCLES                  100000
+
+static uint32_t mostWorn(uint32_t from, uint32_t to) {
+  uint32_t most = 0;
+  for (uint32_t w=from/4; w<to/4; w++) {
+    if ( wear[w] > most ) {
+      most = wear[w];
+    }
+  }
+  return most;
+}
+
+static void testEndurance(void) {
+  reboot();
+  memset( wear, 0, sizeof(wear) );
+  // a button tune, only press_steps changes, the sequence and crc always do
+  config_t c = configN( 0 );
+  unsigned saves = 10 * SLOT_COUNT;
+  for (unsigned n=0; n<saves; n++) {
+    c.press_steps = n;
+    configSave( &c );
+    settle();
+  }
+  uint32_t most = mostWorn( EE_CONFIG, EE_SIZE );
+  uint64_t lasts = (uint64_t)EE_CYCLES * saves / most;
+  printf( "config: %u saves wrote the busiest word %u times, %llu saves to %u cycles\n", saves,
+          (unsigned)most, (unsigned long long)lasts, EE_CYCLES );
+  CHECK( lasts >= (uint64_t)EE_CYCLES * SLOT_COUNT, "config: %llu saves", (unsigned long long)lasts );
+
+  // what main.c does every time the elevator's left still, a save and its clear before
+  // the next move
+  memset( wear, 0, sizeof(wear) );
+  saves = 10 * RESUME_COUNT;
+  for (unsigned n=0; n<saves; n++) {
+    resumeWrite( 1, n * 97 );
+    settle();
+    resumeClear();
+    settle();
+  }
+  most = mostWorn( EE_RESUME, EE_CONFIG );
+  lasts = (uint64_t)EE_CYCLES * saves / most;
+  printf( "resume: %u saves wrote the busiest word %u times, %llu saves to %u cycles\n", saves,
+          (unsigned)most, (unsigned long long)lasts, EE_CYCLES );
+  // what eeprom.c promises
+  CHECK( lasts >= 1400000, "resume: %llu saves", (unsigned long long)lasts );
+  CHECK( mostWorn( 0, EE_RESUME ) == 0 && mostWorn( EE_CONFIG, EE_SIZE ) == 0, "resume: wrote outside its ring" );
+  memset( image, 0, EE_SIZE );
+}
+
+int main(void) {
+  NVIC_SetPriority( FLASH_IRQn, 3 );
+  simFlashDone = flashDone;
+  testCrc();
+  testQueue();
+  testConfig();
+  testTornConfig();
+  testError();
+  testResume();
+  testTornResume();
+  testScan();
+  testEndurance();
+  return simDone( "test_eeprom" );
+}
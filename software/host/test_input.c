@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_input.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+// in with its statics, a sample is a SysTick, a millisecond
+#include "../Core/Src/input.c"
+
+static unsigned limit_calls = 0;
+static bool limit_hit = false;
+
+void myInputLimit(bool hit) {
+  limit_calls++;
+  limit_hit = hit;
+}
+
+// the pin the way the board would have it with the input pressed or hit, or not
+static void drive(input_id_t id, bool on) {
+  simPin( inputs[id].port, inputs[id].pin, on == inputs[id].high );
+}
+
+static void sample(unsigned n) {
+  while ( n-- ) {
+    inputSample();
+  }
+}
+
+// samples until an event is waiting, max+1 if none came
+static unsigned untilEvent(unsigned max) {
+  unsigned n = 0;
+  while ( queue_tail == queue_head && n <= max ) {
+    inputSample();
+    n++;
+  }
+  return n;
+}
+
+static void expect(const char *what, input_id_t want_id, input_event_t want) {
+  input_id_t id = 0;
+  input_event_t event = 0;
+  bool got = inputNext( &id, &event );
+  CHECK( got && id == want_id && event == want, "%s: %s %d %d", what, got ? "got" : "nothing", id, event );
+}
+
+static void expectNothing(const char *what) {
+  input_id_t id;
+  input_event_t event;
+  CHECK( !inputNext( &id, &event ), "%s: got %d %d", what, id, event );
+}
+
+// a press and a release each land INPUT_DEBOUNCE_MS samples after the pin goes, the time
+// held is between the two, and a release before INPUT_LONG_MS is a tap. a hold is posted
+// INPUT_LONG_MS after the press without waiting for the release, which then adds nothing
+static void testTiming(void) {
+  char what[48];
+  for (input_id_t id=input_left; id<=input_right; id++) {
+    // down samples after the press before letting go, the release's own debounce counts
+    // as held up to the one that flips it
+    static const unsigned downs[] = { 0, 100, INPUT_LONG_MS - INPUT_DEBOUNCE_MS, INPUT_LONG_MS - INPUT_DEBOUNCE_MS + 1 };
+    for (unsigned i=0; i<sizeof(downs)/sizeof(downs[0]); i++) {
+      bool tap = downs[i] + INPUT_DEBOUNCE_MS - 1 < INPUT_LONG_MS;
+      snprintf( what, sizeof(what), "%s held %u", id == input_left ? "left" : "right", downs[i] );
+      drive( id, true );
+      unsigned n = untilEvent( 1000 );
+      CHECK( n == INPUT_DEBOUNCE_MS, "%s: press after %u", what, n );
+      expect( what, id, input_press );
+      CHECK( inputActive( id ) && !inputQuiet(), "%s: not active", what );
+      sample( downs[i] );
+      expectNothing( what );
+      drive( id, false );
+      n = untilEvent( 1000 );
+      if ( tap ) {
+        CHECK( n == INPUT_DEBOUNCE_MS, "%s: short after %u", what, n );
+        expect( what, id, input_short );
+      } else {
+        CHECK( n == INPUT_LONG_MS - downs[i], "%s: long after %u", what, n );
+        expect( what, id, input_long );
+        sample( INPUT_DEBOUNCE_MS );
+        expectNothing( what );
+      }
+      CHECK( !inputActive( id ) && inputQuiet(), "%s: still active", what );
+    }
+
+    // held on, the hold comes INPUT_LONG_MS after the press
+    snprintf( what, sizeof(what), "%s hold", id == input_left ? "left" : "right" );
+    drive( id, true );
+    sample( INPUT_DEBOUNCE_MS );
+    expect( what, id, input_press );
+    unsigned n = untilEvent( 1000 );
+    CHECK( n == INPUT_LONG_MS, "%s: long after %u", what, n );
+    expect( what, id, input_long );
+    sample( 2000 );
+    drive( id, false );
+    sample( 2 * INPUT_DEBOUNCE_MS );
+    expectNothing( what );
+    CHECK( inputQuiet(), "%s: not quiet", what );
+  }
+}
+
+// bounce shorter than the debounce, or chatter that never holds either way, gets nowhere.
+// a press that bounces on the way in and out still makes one press and one tap
+static void testGlitch(void) {
+  char what[48];
+  for (input_id_t id=input_left; id<=input_limit; id++) {
+    snprintf( what, sizeof(what), "glitch %d", id );
+    unsigned calls = limit_calls;
+    drive( id, true );
+    sample( INPUT_DEBOUNCE_MS - 1 );
+    drive( id, false );
+    sample( INPUT_DEBOUNCE_MS );
+    for (int i=0; i<200; i++) {
+      drive( id, i & 1 );
+      sample( 1 );
+    }
+    drive( id, false );
+    sample( INPUT_DEBOUNCE_MS );
+    expectNothing( what );
+    CHECK( !inputActive( id ) && limit_calls == calls, "%s: went active", what );
+
+    // three samples in for one out, then the same out, the integrator gets there either way
+    snprintf( what, sizeof(what), "bounce %d", id );
+    for (int i=0; i<4*INPUT_DEBOUNCE_MS; i++) {
+      drive( id, (i & 3) != 3 );
+      sample( 1 );
+    }
+    drive( id, true );
+    sample( INPUT_DEBOUNCE_MS );
+    CHECK( inputActive( id ), "%s: not active", what );
+    for (int i=0; i<4*INPUT_DEBOUNCE_MS; i++) {
+      drive( id, (i & 3) == 3 );
+      sample( 1 );
+    }
+    drive( id, false );
+    sample( INPUT_DEBOUNCE_MS );
+    CHECK( !inputActive( id ), "%s: still active", what );
+    if ( id == input_limit ) {
+      CHECK( limit_calls == calls + 2 && !limit_hit, "%s: %u limit changes", what, limit_calls - calls );
+      expectNothing( what );
+    } else {
+      expect( what, id, input_press );
+      expect( what, id, input_short );
+      expectNothing( what );
+    }
+  }
+}
+
+// taps piling up while the loop is busy keep the oldest the ring has room for and drop the
+// rest, and once it's been emptied it takes them again
+static void testOverflow(void) {
+  for (int i=0; i<INPUT_QUEUE_LEN; i++) {
+    drive( i & 1, true );
+    sample( 2 * INPUT_DEBOUNCE_MS );
+    drive( i & 1, false );
+    sample( 2 * INPUT_DEBOUNCE_MS );
+  }
+  CHECK( !inputQuiet(), "overflow: quiet" );
+  for (int i=0; i<INPUT_QUEUE_LEN-1; i++) {
+    expect( "overflow", (i/2) & 1, (i & 1) ? input_short : input_press );
+  }
+  expectNothing( "overflow" );
+  CHECK( inputQuiet(), "overflow: not quiet" );
+
+  drive( input_right, true );
+  sample( 2 * INPUT_DEBOUNCE_MS );
+  drive( input_right, false );
+  sample( 2 * INPUT_DEBOUNCE_MS );
+  expect( "after overflow", input_right, input_press );
+  expect( "after overflow", input_right, input_short );
+  expectNothing( "after overflow" );
+}
+
+// whatever the pins are at the start is taken as settled, without an event
+static void testStart(void) {
+  CHECK( !sampling, "start: sampling" );
+  drive( input_limit, true );
+  sample( 2 * INPUT_DEBOUNCE_MS );
+  CHECK( !inputActive( input_limit ) && limit_calls == 0, "start: sampled before inputStart()" );
+  inputStart();
+  CHECK( inputActive( input_limit ) && !inputActive( input_left ) && !inputActive( input_right ),
+         "start: %02x", active );
+  sample( 2 * INPUT_DEBOUNCE_MS );
+  CHECK( limit_calls == 0 && inputQuiet(), "start: %u limit changes", limit_calls );
+  drive( input_limit, false );
+  sample( INPUT_DEBOUNCE_MS );
+  CHECK( limit_calls == 1 && !limit_hit, "start: limit %u %d", limit_calls, limit_hit );
+  limit_calls = 0;
+}
+
+int main(void) {
+  testStart();
+  testTiming();
+  testGlitch();
+  testOverflow();
+  return simDone( "test_input" );
+}
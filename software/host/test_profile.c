@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_profile.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+// built with PROFILE, main.c only for cycles() and the SysTick it counts from, its main()
+// never runs. the sim keeps SysTick->VAL and PENDSTSET where cycles() reads them, every
+// 1/4us is 8 cycles of the 32MHz sysclock
+#define main firmware_main
+#include "../Core/Src/main.c"
+#undef main
+
+#define CYCLES_PER_TICK            (32000000 / 1000000 / SIM_TICKS_PER_US)
+
+// cycles() against the sim's own time, from the last call
+static uint64_t ref_time;
+static uint32_t ref_cycles;
+
+static void mark(void) {
+  ref_time = simTime();
+  ref_cycles = cycles();
+}
+
+static void expectCycles(const char *what) {
+  uint32_t got = cycles() - ref_cycles;
+  uint32_t want = (uint32_t)((simTime() - ref_time) * CYCLES_PER_TICK);
+  CHECK( got == want, "%s: %u cycles over %u", what, (unsigned)got, (unsigned)want );
+}
+
+// every us across a few reloads, then odd strides so it lands on and either side of
+// each reload, and the ms count past where ms*(LOAD+1) wraps 32 bits
+static void testReloads(void) {
+  char what[48];
+  mark();
+  for (int i=0; i<3000; i++) {
+    simRun( 1 );
+    snprintf( what, sizeof(what), "us %d", i );
+    expectCycles( what );
+  }
+  for (unsigned stride=1; stride<1200; stride+=37) {
+    mark();
+    simRun( stride );
+    snprintf( what, sizeof(what), "stride %uus", stride );
+    expectCycles( what );
+  }
+  systick = 0xFFFFFFFFu / 32000 - 2;
+  mark();
+  for (int i=0; i<8; i++) {
+    simRun( 500 );
+    snprintf( what, sizeof(what), "wrap %d", i );
+    expectCycles( what );
+  }
+}
+
+// the SysTick held off past its reload, the count still runs on from VAL with the ms the
+// handler hasn't added yet, for up to half a ms
+static void testPending(void) {
+  char what[48];
+  for (unsigned late=1; late<500; late+=61) {
+    simRun( (2000 - (simTime() / SIM_US(1)) % 1000 - 3) % 1000 );
+    mark();
+    uint32_t ms = systick;
+    __disable_irq();
+    simRun( 3 + late );
+    snprintf( what, sizeof(what), "held %uus", late );
+    CHECK( systick == ms && (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk), "%s: the handler ran", what );
+    expectCycles( what );
+    __enable_irq();
+    CHECK( systick == ms + 1, "%s: the handler didn't run", what );
+    expectCycles( what );
+  }
+}
+
+static void region(prof_region_t r, uint32_t us) {
+  profileBegin( r );
+  simRun( us );
+  profileEnd( r );
+}
+
+// count, min, max and total in cycles, across reloads, with the overhead taken off and a
+// lap counting from the one before
+static void testRegions(void) {
+  profileStart();
+  CHECK( profile_overhead == 0, "regions: overhead %u, nothing takes time here", (unsigned)profile_overhead );
+  static const uint32_t us[] = { 10, 50, 20, 1700, 3 };
+  uint64_t total = 0;
+  for (unsigned i=0; i<sizeof(us)/sizeof(us[0]); i++) {
+    region( prof_wpc, us[i] );
+    total += us[i] * 32;
+  }
+  CHECK( profile[prof_wpc].count == 5 && profile[prof_wpc].min == 3*32 && profile[prof_wpc].max == 1700*32 &&
+         profile[prof_wpc].total == total && profile[prof_wpc].at == 0,
+         "regions: %u, min %u, max %u, total %llu", (unsigned)profile[prof_wpc].count, (unsigned)profile[prof_wpc].min,
+         (unsigned)profile[prof_wpc].max, (unsigned long long)profile[prof_wpc].total );
+
+  // an end with no begin is dropped
+  profileEnd( prof_buttons );
+  CHECK( profile[prof_buttons].count == 0, "regions: counted an end without a begin" );
+
+  // the first lap only begins
+  for (int i=0; i<4; i++) {
+    profileLap( prof_loop );
+    simRun( 100 * (i+1) );
+  }
+  CHECK( profile[prof_loop].count == 3 && profile[prof_loop].min == 100*32 && profile[prof_loop].max == 300*32 &&
+         profile[prof_loop].total == 600*32, "laps: %u, min %u, max %u, total %llu", (unsigned)profile[prof_loop].count,
+         (unsigned)profile[prof_loop].min, (unsigned)profile[prof_loop].max, (unsigned long long)profile[prof_loop].total );
+
+  // what a begin and end cost on the board comes off every figure, never below nothing
+  profile_overhead = 40;
+  region( prof_exti, 2 );
+  region( prof_exti, 1 );
+  profile_overhead = 100;
+  region( prof_exti, 0 );
+  CHECK( profile[prof_exti].count == 3 && profile[prof_exti].min == 0 && profile[prof_exti].max == 64 - 40 &&
+         profile[prof_exti].total == 64 - 40, "overhead: %u, min %u, max %u, total %llu",
+         (unsigned)profile[prof_exti].count, (unsigned)profile[prof_exti].min, (unsigned)profile[prof_exti].max,
+         (unsigned long long)profile[prof_exti].total );
+}
+
+int main(void) {
+  SystemCoreClock = 32000000;
+  SysTick_Config( SystemCoreClock / 1000 );
+  // off 0, which a region's begin takes as not begun
+  simRun( 1 );
+  testReloads();
+  testPending();
+  testRegions();
+  return simDone( "test_profile" );
+}
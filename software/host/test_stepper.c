@@ -0,0 +1,390 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_stepper.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+// in with its statics, the checks compare a run against what the planner meant by it
+#include "../Core/Src/stepper.c"
+
+// runs here go at 1/8 unless they say, 4 usteps a pulse
+#define UNIT                       (USTEPS_PER_STEP >> step_size_8th)
+#define TIMES_LEN                  20000
+
+static const step_profile_t trapezoid = { 100, 1200, 8000, ramp_trapezoid };
+static const step_profile_t scurve = { 100, 1200, 8000, ramp_scurve };
+
+static int done = 0;
+static uint64_t done_at;
+static int opto = 0;
+static int32_t opto_position;
+
+// every pulse of the run, and something to do at one of them as if the loop did it then
+static uint32_t timed = 0;
+static uint64_t times[TIMES_LEN];
+static void (*at_pulse)(void);
+static uint32_t at_pulse_n;
+
+void myStepperDone(void) {
+  done++;
+  done_at = simTime();
+}
+
+void myStepperOpto(void) {
+  opto++;
+  opto_position = stepperPosition();
+}
+
+static void stepped(void) {
+  if ( timed < TIMES_LEN ) {
+    times[timed] = simTime();
+  }
+  timed++;
+  if ( at_pulse && timed == at_pulse_n ) {
+    at_pulse();
+  }
+}
+
+static void setup(void) {
+  // what MX_DMA_Init(), MX_TIM2_Init() and MX_TIM21_Init() leave for the stepper
+  NVIC_SetPriority( TIM21_IRQn, 0 );
+  NVIC_SetPriority( TIM2_IRQn, 1 );
+  NVIC_SetPriority( DMA1_Channel2_3_IRQn, 1 );
+  LL_DMA_ConfigTransfer( DMA1, LL_DMA_CHANNEL_2, LL_DMA_DIRECTION_MEMORY_TO_PERIPH |
+                         LL_DMA_PRIORITY_VERYHIGH | LL_DMA_MODE_CIRCULAR |
+                         LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                         LL_DMA_PDATAALIGN_WORD | LL_DMA_MDATAALIGN_HALFWORD );
+  LL_DMA_EnableIT_HT( DMA1, LL_DMA_CHANNEL_2 );
+  LL_DMA_EnableIT_TC( DMA1, LL_DMA_CHANNEL_2 );
+  LL_TIM_EnableIT_UPDATE( TIM21 );
+  LL_TIM_EnableCounter( TIM21 );
+  // the driver out of reset and enabled, its indexer home at position 0
+  pinsAssign( GPIOA, S_NRST_Pin | S_NEN_Pin, S_NRST_Pin );
+  simStep = stepped;
+}
+
+static void begin(void) {
+  done = 0;
+  opto = 0;
+  timed = 0;
+  at_pulse = NULL;
+}
+
+// wait the run out, and a while after for anything that shouldn't still happen
+static void finish(void) {
+  while ( stepperBusy() ) {
+    simWait();
+  }
+  simRun( 20000 );
+}
+
+// index of the first pulse that didn't follow the one before by period, 0 for none
+static uint32_t offPeriod(uint32_t from, uint32_t to, uint32_t period) {
+  for (uint32_t i = from ? from : 1; i < to && i < TIMES_LEN; i++) {
+    if ( times[i] - times[i-1] != period ) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+// the carriage went as far as the firmware thinks it did, and exactly once done
+static void checkRun(const char *what, int32_t from, int32_t carriage_from) {
+  int32_t moved = stepperPosition() - from;
+  CHECK( done == 1, "%s: done %d times", what, done );
+  CHECK( !stepperBusy(), "%s: still busy", what );
+  CHECK( simCarriage() - carriage_from == moved, "%s: carriage went %d, position %d",
+         what, (int)(simCarriage() - carriage_from), (int)moved );
+}
+
+// fixed rate runs either side of where the ring takes over and hands back
+static void testFixed(void) {
+  static const uint32_t counts[] = { 1, 2, 3, 31, 32, 33, 34, 35, 64, 65, 66, 67, 96, 97, 98, 99, 129, 1000 };
+  stepSize( step_size_8th );
+  for (int dir=0; dir<2; dir++) {
+    stepperDirection( dir ? step_dir_down : step_dir_up );
+    for (size_t i=0; i<sizeof(counts)/sizeof(counts[0]); i++) {
+      uint32_t n = counts[i];
+      int32_t from = stepperPosition();
+      int32_t carriage = simCarriage();
+      char what[32];
+      snprintf( what, sizeof(what), "fixed %u %s", (unsigned)n, dir ? "down" : "up" );
+      begin();
+      uint64_t t0 = simTime();
+      stepperStart( n, 400 );
+      finish();
+      checkRun( what, from, carriage );
+      CHECK( timed == n, "%s: %u pulses", what, (unsigned)timed );
+      CHECK( stepperPosition() - from == (dir ? -1 : 1) * (int32_t)(n * UNIT), "%s: position %d from %d",
+             what, (int)stepperPosition(), (int)from );
+      uint32_t off = offPeriod( 0, n, 400 );
+      CHECK( off == 0, "%s: pulse %u after %u", what, (unsigned)off, (unsigned)(times[off] - times[off-1]) );
+      CHECK( done_at == t0 + n * 400, "%s: done %u ticks in", what, (unsigned)(done_at - t0) );
+    }
+  }
+}
+
+// every segment of a table for exactly its pulses
+static void testStream(void) {
+  static const step_segment_t table[] = { { 5, 400 }, { 40, 300 }, { 1, 900 }, { 70, 200 }, { 3, 1000 } };
+  stepSize( step_size_8th );
+  stepperDirection( step_dir_up );
+  int32_t from = stepperPosition();
+  int32_t carriage = simCarriage();
+  begin();
+  uint64_t t0 = simTime();
+  stepperStream( table, 5 );
+  finish();
+  checkRun( "stream", from, carriage );
+  uint32_t n = 0;
+  uint64_t end = t0;
+  for (int s=0; s<5; s++) {
+    for (uint32_t p=0; p<table[s].pulses; p++, n++) {
+      if ( n+1 < timed ) {
+        CHECK( times[n+1] - times[n] == table[s].period, "stream: pulse %u after %u, segment %d wants %u",
+               (unsigned)(n+1), (unsigned)(times[n+1] - times[n]), s, (unsigned)table[s].period );
+      }
+      end += table[s].period;
+    }
+  }
+  CHECK( timed == n, "stream: %u pulses of %u", (unsigned)timed, (unsigned)n );
+  CHECK( done_at == end, "stream: done %u ticks in, wants %u", (unsigned)(done_at - t0), (unsigned)(end - t0) );
+}
+
+// planned moves end where they were headed and never go faster than the profile
+static void testMove(const step_profile_t *profile, step_size_t size, const char *name) {
+  static const uint32_t pulses[] = { 1, 2, 3, 33, 34, 65, 66, 97, 98, 129, 500, 2000, 14000 };
+  stepSize( size );
+  uint32_t unit = USTEPS_PER_STEP >> size;
+  uint32_t fastest = STEP_TIMER_HZ * unit / (profile->speed * USTEPS_PER_STEP);
+  for (int dir=0; dir<2; dir++) {
+    stepperDirection( dir ? step_dir_down : step_dir_up );
+    for (size_t i=0; i<sizeof(pulses)/sizeof(pulses[0]); i++) {
+      // a ustep over so the move rounds down to whole pulses, except at 1/32
+      uint32_t usteps = pulses[i] * unit + (unit > 1);
+      int32_t from = stepperPosition();
+      int32_t carriage = simCarriage();
+      char what[48];
+      snprintf( what, sizeof(what), "%s %u %s", name, (unsigned)usteps, dir ? "down" : "up" );
+      begin();
+      stepperMove( usteps, profile );
+      finish();
+      checkRun( what, from, carriage );
+      int32_t want = (int32_t)(pulses[i] * unit);
+      CHECK( stepperPosition() - from == (dir ? -want : want), "%s: went %d", what, (int)(stepperPosition() - from) );
+#ifndef STEP_COARSE
+      CHECK( timed == pulses[i], "%s: %u pulses", what, (unsigned)timed );
+#endif
+      for (uint32_t p=1; p<timed && p<TIMES_LEN; p++) {
+        if ( times[p] - times[p-1] < fastest ) {
+          CHECK( false, "%s: pulse %u after %u, faster than %u", what, (unsigned)p,
+                 (unsigned)(times[p] - times[p-1]), (unsigned)fastest );
+          break;
+        }
+      }
+    }
+  }
+}
+
+static void slowDown(void) {
+  stepperDecelerate();
+}
+
+// a stop asked for at any pulse still ends with the position where the pulses put it,
+// and slows all the way down once the planner has caught up
+static void testDecelerate(step_size_t size, const char *name) {
+  stepSize( size );
+  uint32_t unit = USTEPS_PER_STEP >> size;
+  uint32_t usteps = USTEPS_PER_LEVEL / 4;
+  uint32_t full = usteps / unit;
+  for (int dir=0; dir<2; dir++) {
+    stepperDirection( dir ? step_dir_down : step_dir_up );
+    for (uint32_t k=1; k<full; k += 1 + k/8) {
+      int32_t from = stepperPosition();
+      int32_t carriage = simCarriage();
+      char what[48];
+      snprintf( what, sizeof(what), "%s at %u %s", name, (unsigned)k, dir ? "down" : "up" );
+      begin();
+      at_pulse = slowDown;
+      at_pulse_n = k;
+      stepperMove( usteps, &trapezoid );
+      finish();
+      checkRun( what, from, carriage );
+      // going coarse at 1/32 makes pulses and usteps part company, only the position holds
+      bool whole = true;
+#ifdef STEP_COARSE
+      whole = ( unit > 1 );
+#endif
+      if ( !whole ) {
+        continue;
+      }
+      CHECK( stepperPosition() - from == (dir ? -1 : 1) * (int32_t)(timed * unit), "%s: %u pulses, went %d",
+             what, (unsigned)timed, (int)(stepperPosition() - from) );
+      // ramping down takes no more than ramping up did, past what the ring already held
+      uint32_t late = k + STEP_DMA_LEN + 2;
+      CHECK( timed <= 2*late || timed == full, "%s: %u pulses", what, (unsigned)timed );
+      for (uint32_t p=late+1; p<timed && p<TIMES_LEN; p++) {
+        if ( times[p] - times[p-1] < times[p-1] - times[p-2] ) {
+          CHECK( false, "%s: pulse %u sped up after the stop", what, (unsigned)p );
+          break;
+        }
+      }
+    }
+  }
+}
+
+static int32_t shift_by;
+
+static void shift(void) {
+  stepperShift( shift_by );
+}
+
+// a correction part way along moves the position, a planned move still ends where it was
+// headed and a fixed run still goes its pulses
+static void testShift(void) {
+  static const int32_t shifts[] = { 40, -40, 3, -3 };
+  stepSize( step_size_8th );
+  for (int dir=0; dir<2; dir++) {
+    stepperDirection( dir ? step_dir_down : step_dir_up );
+    for (int i=0; i<4; i++) {
+      int way = dir ? -1 : 1;
+      int32_t from = stepperPosition();
+      int32_t carriage = simCarriage();
+      char what[48];
+      snprintf( what, sizeof(what), "shift %d move %s", (int)shifts[i], dir ? "down" : "up" );
+      begin();
+      shift_by = shifts[i];
+      at_pulse = shift;
+      at_pulse_n = 200;
+      stepperMove( 4000, &trapezoid );
+      finish();
+      // the plan gives or takes whole pulses, what's left of the correction stays in the position
+      int32_t s = (dir ? shifts[i] : -shifts[i]) & ~(int32_t)(UNIT-1);
+      CHECK( done == 1, "%s: done %d times", what, done );
+      CHECK( simCarriage() - carriage == way * (4000 + s), "%s: carriage went %d", what,
+             (int)(simCarriage() - carriage) );
+      CHECK( stepperPosition() - from == simCarriage() - carriage + shifts[i], "%s: went %d", what,
+             (int)(stepperPosition() - from) );
+
+      snprintf( what, sizeof(what), "shift %d fixed %s", (int)shifts[i], dir ? "down" : "up" );
+      from = stepperPosition();
+      carriage = simCarriage();
+      begin();
+      at_pulse = shift;
+      at_pulse_n = 50;
+      stepperStart( 300, 300 );
+      finish();
+      CHECK( timed == 300, "%s: %u pulses", what, (unsigned)timed );
+      CHECK( stepperPosition() - from == way * 300 * UNIT + shifts[i], "%s: went %d", what,
+             (int)(stepperPosition() - from) );
+      CHECK( simCarriage() - carriage == way * 300 * UNIT, "%s: carriage went %d", what,
+             (int)(simCarriage() - carriage) );
+    }
+  }
+}
+
+static int32_t arm_at;
+
+static void arm(void) {
+  stepperOptoAt( arm_at );
+}
+
+// the opto callback comes on the first pulse that reaches the armed position, whenever it's
+// armed and however far the count has wrapped
+static void testOpto(void) {
+  stepSize( step_size_8th );
+  for (int dir=0; dir<2; dir++) {
+    int way = dir ? -1 : 1;
+    stepperDirection( dir ? step_dir_down : step_dir_up );
+    char what[48];
+
+    int32_t from = stepperPosition();
+    snprintf( what, sizeof(what), "opto ahead %s", dir ? "down" : "up" );
+    begin();
+    stepperOptoAt( from + way * 101 );
+    stepperMove( 1000, &trapezoid );
+    finish();
+    CHECK( opto == 1 && opto_position == from + way * 104, "%s: %d calls, at %d", what, opto,
+           (int)(opto_position - from) );
+
+    from = stepperPosition();
+    snprintf( what, sizeof(what), "opto mid run %s", dir ? "down" : "up" );
+    begin();
+    arm_at = from + way * 2001;
+    at_pulse = arm;
+    at_pulse_n = 100;
+    stepperMove( 4000, &trapezoid );
+    finish();
+    CHECK( opto == 1 && opto_position == from + way * 2004, "%s: %d calls, at %d", what, opto,
+           (int)(opto_position - from) );
+
+    from = stepperPosition();
+    snprintf( what, sizeof(what), "opto behind %s", dir ? "down" : "up" );
+    begin();
+    arm_at = from + way * 40;
+    at_pulse = arm;
+    at_pulse_n = 100;
+    stepperMove( 4000, &trapezoid );
+    finish();
+    CHECK( opto == 1 && opto_position == from + way * 400, "%s: %d calls, at %d", what, opto,
+           (int)(opto_position - from) );
+  }
+
+  // past the 16 bit compare's first match, at 1/32 a pulse is a ustep
+  stepSize( step_size_32nd );
+  stepperDirection( step_dir_up );
+  int32_t from = stepperPosition();
+  int32_t carriage = simCarriage();
+  begin();
+  stepperOptoAt( from + 70000 );
+  stepperStart( 75000, 40 );
+  finish();
+  checkRun( "opto wrapped", from, carriage );
+  CHECK( opto == 1 && opto_position == from + 70000, "opto wrapped: %d calls, at %d", opto,
+         (int)(opto_position - from) );
+  stepperOptoOff();
+}
+
+// a size that doesn't land on the indexer's grid comes out short on its first pulse
+static void testPhase(void) {
+  static const step_size_t sizes[] = { step_size_32nd, step_size_8th, step_size_half, step_size_16th, step_size_full };
+  for (int i=0; i<5; i++) {
+    for (int dir=0; dir<2; dir++) {
+      stepSize( sizes[i] );
+      stepperDirection( dir ? step_dir_down : step_dir_up );
+      int32_t from = stepperPosition();
+      int32_t carriage = simCarriage();
+      begin();
+      stepperStart( 3, 2000 );
+      finish();
+      checkRun( "phase", from, carriage );
+      stepSize( step_size_32nd );
+      from = stepperPosition();
+      carriage = simCarriage();
+      begin();
+      stepperStart( 1 + i, 2000 );
+      finish();
+      checkRun( "phase 1/32", from, carriage );
+    }
+  }
+}
+
+int main(void) {
+  setup();
+  testFixed();
+  testStream();
+  testMove( &trapezoid, step_size_8th, "trapezoid" );
+  testMove( &scurve, step_size_8th, "scurve" );
+  testMove( &trapezoid, step_size_32nd, "trapezoid 1/32" );
+  testDecelerate( step_size_8th, "decelerate" );
+  testDecelerate( step_size_32nd, "decelerate 1/32" );
+  testShift();
+  testOpto();
+  testPhase();
+#ifdef STEP_COARSE
+  return simDone( "test_stepper_coarse" );
+#else
+  return simDone( "test_stepper" );
+#endif
+}
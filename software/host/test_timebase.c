@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_timebase.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+#include "../Core/Src/timebase.c"
+
+#define WRAPS                      5
+
+// every read polls the flag, so the sim moves a us each time and micros() has to follow it
+// one count at a time, through the match on ARR and the interrupt that takes it
+static void testWraps(void) {
+  uint32_t was = micros();
+  uint64_t base = simTime();
+  unsigned bad = 0;
+  for (uint32_t i=0; i<WRAPS * 0x10000u; i++) {
+    uint32_t now = micros();
+    if ( now - was > 1 ) {
+      if ( !bad++ ) {
+        CHECK( false, "wraps: %u after %u", (unsigned)now, (unsigned)was );
+      }
+    }
+    was = now;
+  }
+  CHECK( bad == 0, "wraps: %u bad reads", bad );
+  CHECK( count_hi >= WRAPS * 0x10000u, "wraps: only %u wrapped", (unsigned)(count_hi >> 16) );
+  uint32_t elapsed = (simTime() - base) / SIM_TICKS_PER_US;
+  CHECK( was - elapsed <= 2 || elapsed - was <= 2, "wraps: %u after %u us", (unsigned)was, (unsigned)elapsed );
+}
+
+// a wait never comes up short, however it lines up with a wrap
+static void testDelay(void) {
+  for (uint32_t us=1; us<0x30000; us=us*3+7) {
+    for (int lead=0; lead<4; lead++) {
+      // start just short of the next match
+      while ( (uint16_t)micros() != (uint16_t)(0xFFFF - lead) );
+      uint64_t start = simTime();
+      delayUs( us );
+      uint64_t took = (simTime() - start) / SIM_TICKS_PER_US;
+      CHECK( took >= us && took <= us + 3, "delay %u from %u: took %u", (unsigned)us, 0xFFFF - lead, (unsigned)took );
+    }
+  }
+}
+
+int main(void) {
+  // what MX_LPTIM1_Init() leaves for the timebase
+  NVIC_SetPriority( LPTIM1_IRQn, 2 );
+  timebaseStart();
+  testWraps();
+  testDelay();
+  return simDone( "test_timebase" );
+}
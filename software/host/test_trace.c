@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_trace.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../Core/Src/trace.c"
+#include "trace_decode.h"
+
+#define SENT_LEN                   256
+
+// what went in, with the time micros() had for it
+static trace_record_t sent[SENT_LEN];
+static int sent_len = 0;
+static uint64_t base;
+
+static trace_decoder_t decoder;
+static trace_record_t got[SENT_LEN];
+static int got_len = 0;
+static uint32_t got_lost = 0;
+
+static void event(trace_t e, uint32_t arg) {
+  if ( sent_len < SENT_LEN ) {
+    sent[sent_len].us = (simTime() - base) / SIM_TICKS_PER_US;
+    sent[sent_len].event = e;
+    sent[sent_len].arg = arg;
+    sent_len++;
+  }
+  traceEvent( e, arg );
+}
+
+// let the dma send it all and decode what came out
+static void drain(void) {
+  simRun( 100000 );
+  uint8_t bytes[1024];
+  size_t n;
+  while ( (n = simTraceTx( bytes, sizeof(bytes) )) ) {
+    for (size_t i=0; i<n; i++) {
+      trace_record_t r;
+      if ( traceDecode( &decoder, bytes[i], &r ) ) {
+        if ( r.event == trace_lost ) {
+          got_lost += r.arg;
+        } else if ( got_len < SENT_LEN ) {
+          got[got_len++] = r;
+        }
+      }
+    }
+  }
+}
+
+// every event that wasn't counted lost came out in order, at its time, with its argument
+static void compare(const char *what) {
+  int g = 0;
+  for (int s=0; s<sent_len && g<got_len; s++) {
+    if ( got[g].event != sent[s].event || got[g].arg != sent[s].arg ) {
+      // dropped, the lost count has to cover it
+      continue;
+    }
+    CHECK( got[g].us == sent[s].us, "%s: event %d at %u, sent at %u", what, s, (unsigned)got[g].us,
+           (unsigned)sent[s].us );
+    g++;
+  }
+  CHECK( g == got_len, "%s: %d of %d decoded events matched", what, g, got_len );
+  CHECK( (uint32_t)got_len + got_lost == (uint32_t)sent_len, "%s: %d sent, %d decoded, %u lost", what,
+         sent_len, got_len, (unsigned)got_lost );
+}
+
+static void reset(void) {
+  sent_len = 0;
+  got_len = 0;
+  got_lost = 0;
+}
+
+// the argument and the time between events at every varint length, across the timebase's
+// wraps, and signed arguments through the zigzag
+static void testValues(void) {
+  static const uint32_t args[] = { 0, 1, 127, 128, 16383, 16384, 2097151, 2097152, 268435455, 268435456, 0xFFFFFFFF };
+  static const uint32_t gaps[] = { 0, 5, 200, 70000, 3000000, 1 };
+  reset();
+  for (size_t i=0; i<sizeof(args)/sizeof(args[0]); i++) {
+    simRun( gaps[i % 6] );
+    event( trace_refill, args[i] );
+    drain();
+  }
+  static const int32_t values[] = { 0, -1, 1, -64, 64, INT32_MIN, INT32_MAX };
+  for (size_t i=0; i<sizeof(values)/sizeof(values[0]); i++) {
+    event( trace_done, TRACE_ZIGZAG( values[i] ) );
+    CHECK( TRACE_UNZIGZAG( TRACE_ZIGZAG( values[i] ) ) == values[i], "zigzag %d", (int)values[i] );
+  }
+  CHECK( TRACE_ZIGZAG( -1 ) == 1 && TRACE_ZIGZAG( 1 ) == 2 && TRACE_ZIGZAG( -64 ) == 127, "zigzag: small values" );
+  drain();
+  compare( "values" );
+  CHECK( got_lost == 0, "values: %u lost", (unsigned)got_lost );
+}
+
+// more at once than the ring holds, what doesn't fit is counted and the count goes out
+// ahead of the next event there's room for
+static void testLost(void) {
+  reset();
+  for (int i=0; i<60; i++) {
+    event( trace_run, 1000 + i );
+  }
+  CHECK( lost > 0, "lost: nothing dropped" );
+  simRun( 50000 );
+  event( trace_command, 3 );
+  drain();
+  compare( "lost" );
+  CHECK( got_lost > 0 && got_len > 0 && got[got_len-1].event == trace_command, "lost: %u lost, last %d",
+         (unsigned)got_lost, got_len ? (int)got[got_len-1].event : -1 );
+}
+
+// the decoder doesn't care how the bytes are split
+static void testDecoder(void) {
+  static const uint8_t stream[] = { trace_start, 0x80, 0x01, 0x00, trace_done, 0x05, 0x83, 0x80, 0x80, 0x80, 0x0F };
+  trace_decoder_t d;
+  traceDecodeInit( &d );
+  trace_record_t r[2];
+  int n = 0;
+  for (size_t i=0; i<sizeof(stream); i++) {
+    if ( traceDecode( &d, stream[i], &r[n] ) ) {
+      n++;
+    }
+  }
+  CHECK( n == 2, "decoder: %d events", n );
+  CHECK( r[0].event == trace_start && r[0].us == 128 && r[0].arg == 0, "decoder: start at %u", (unsigned)r[0].us );
+  CHECK( r[1].event == trace_done && r[1].us == 133 && r[1].arg == 0xF0000003, "decoder: done %08x", (unsigned)r[1].arg );
+  CHECK( traceName( trace_limit_level ) && !strcmp( traceName( trace_limit_level ), "limit_level" ) &&
+         !traceName( 200 ), "decoder: names" );
+}
+
+int main(void) {
+  // what MX_LPTIM1_Init() and MX_USART2_Init() leave for the trace
+  NVIC_SetPriority( LPTIM1_IRQn, 2 );
+  NVIC_SetPriority( DMA1_Channel4_5_IRQn, 3 );
+  LL_DMA_SetDataTransferDirection( DMA1, LL_DMA_CHANNEL_4, LL_DMA_DIRECTION_MEMORY_TO_PERIPH );
+  LL_DMA_SetMemoryIncMode( DMA1, LL_DMA_CHANNEL_4, LL_DMA_MEMORY_INCREMENT );
+  simRun( 1234 );
+  timebaseStart();
+  base = simTime();
+  traceDecodeInit( &decoder );
+  simRun( 10 );
+  sent[0].us = (simTime() - base) / SIM_TICKS_PER_US;
+  sent[0].event = trace_start;
+  sent[0].arg = 0;
+  sent_len = 1;
+  traceStart();
+  drain();
+  compare( "start" );
+  testValues();
+  testLost();
+  testDecoder();
+  return simDone( "test_trace" );
+}
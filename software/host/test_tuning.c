@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_tuning.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../Core/Src/tuning.c"
+
+static config_t config = { 12, 100, 1200, 8000, { { 100, 200 }, { 300, 400 } } };
+static int32_t *const words = (int32_t *)&config;
+
+static void frame(uint8_t *f, uint8_t sync, uint8_t cmd, uint8_t id, int32_t value) {
+  f[0] = sync;
+  f[1] = cmd;
+  f[2] = id;
+  f[3] = value;
+  f[4] = value >> 8;
+  f[5] = value >> 16;
+  f[6] = value >> 24;
+  f[7] = sum( f );
+}
+
+static void request(uint8_t cmd, uint8_t id, int32_t value) {
+  uint8_t f[TUNING_FRAME];
+  frame( f, TUNING_SYNC, cmd, id, value );
+  simUartRx( f, TUNING_FRAME );
+}
+
+// the one reply waiting is exactly this
+static void expect(const char *what, uint8_t cmd, uint8_t id, int32_t value) {
+  uint8_t want[TUNING_FRAME], got[2*TUNING_FRAME];
+  frame( want, TUNING_REPLY, cmd, id, value );
+  size_t n = simUartTx( got, sizeof(got) );
+  CHECK( n == TUNING_FRAME && memcmp( got, want, TUNING_FRAME ) == 0, "%s: %u bytes, %02x %02x %02x %02x%02x%02x%02x %02x",
+         what, (unsigned)n, got[0], got[1], got[2], got[6], got[5], got[4], got[3], got[7] );
+}
+
+static void expectNothing(const char *what) {
+  uint8_t got[2*TUNING_FRAME];
+  size_t n = simUartTx( got, sizeof(got) );
+  CHECK( n == 0, "%s: %u bytes sent", what, (unsigned)n );
+}
+
+static void testGetSet(void) {
+  char what[32];
+  for (unsigned id=0; id<CONFIG_WORDS; id++) {
+    snprintf( what, sizeof(what), "get %u", id );
+    request( TUNING_GET, id, 0x55555555 );
+    CHECK( !tuningPoll( &config ), "%s: committed", what );
+    expect( what, TUNING_GET, id, words[id] );
+
+    // either end of the range goes in, a step past it is refused with what's there
+    snprintf( what, sizeof(what), "set %u", id );
+    request( TUNING_SET, id, limits[id].min );
+    request( TUNING_SET, id, limits[id].max );
+    tuningPoll( &config );
+    uint8_t got[2*TUNING_FRAME], want[2*TUNING_FRAME];
+    frame( want, TUNING_REPLY, TUNING_SET, id, limits[id].min );
+    frame( want + TUNING_FRAME, TUNING_REPLY, TUNING_SET, id, limits[id].max );
+    CHECK( simUartTx( got, sizeof(got) ) == 2*TUNING_FRAME && memcmp( got, want, sizeof(want) ) == 0,
+           "%s: replies", what );
+    CHECK( words[id] == limits[id].max, "%s: holds %d", what, (int)words[id] );
+
+    snprintf( what, sizeof(what), "set %u over", id );
+    request( TUNING_SET, id, limits[id].max + 1 );
+    tuningPoll( &config );
+    expect( what, TUNING_SET | TUNING_REFUSED, id, limits[id].max );
+    snprintf( what, sizeof(what), "set %u under", id );
+    request( TUNING_SET, id, limits[id].min - 1 );
+    tuningPoll( &config );
+    expect( what, TUNING_SET | TUNING_REFUSED, id, limits[id].max );
+    CHECK( words[id] == limits[id].max, "%s: holds %d", what, (int)words[id] );
+  }
+
+  request( TUNING_GET, CONFIG_WORDS, 0 );
+  tuningPoll( &config );
+  expect( "get past the end", TUNING_GET | TUNING_REFUSED, CONFIG_WORDS, 0 );
+  request( TUNING_SET, 0xFF, 0 );
+  tuningPoll( &config );
+  expect( "set past the end", TUNING_SET | TUNING_REFUSED, 0xFF, 0 );
+  request( 'X', 1, 0 );
+  tuningPoll( &config );
+  expect( "unknown command", 'X' | TUNING_REFUSED, 1, words[1] );
+}
+
+// a commit is answered once the save says how it went, and only then
+static void testCommit(void) {
+  request( TUNING_COMMIT, 3, 0 );
+  CHECK( tuningPoll( &config ), "commit: not asked for" );
+  expectNothing( "commit before the save" );
+  tuningSaved( true );
+  expect( "commit", TUNING_COMMIT, 3, 0 );
+  tuningSaved( true );
+  expectNothing( "second save" );
+
+  request( TUNING_COMMIT, 4, 0 );
+  CHECK( tuningPoll( &config ), "commit: not asked for" );
+  tuningSaved( false );
+  expect( "commit failed", TUNING_COMMIT | TUNING_REFUSED, 4, 0 );
+}
+
+// line noise, a bad checksum or a frame cut in two all come back into step on a good frame
+static void testSync(void) {
+  static const uint8_t noise[] = { 0x00, TUNING_SYNC, 0xFF, TUNING_SYNC, TUNING_SYNC, 0x12 };
+  simUartRx( noise, sizeof(noise) );
+  uint8_t f[TUNING_FRAME];
+  frame( f, TUNING_SYNC, TUNING_SET, 0, 7 );
+  f[7] ^= 1;
+  simUartRx( f, TUNING_FRAME );
+  request( TUNING_SET, 0, -7 );
+  CHECK( !tuningPoll( &config ), "sync: committed" );
+  expect( "sync", TUNING_SET, 0, -7 );
+  CHECK( config.press_steps == -7, "sync: press_steps %d", (int)config.press_steps );
+
+  frame( f, TUNING_SYNC, TUNING_GET, 2, 0 );
+  simUartRx( f, 5 );
+  tuningPoll( &config );
+  expectNothing( "split" );
+  simUartRx( f + 5, 3 );
+  tuningPoll( &config );
+  expect( "split", TUNING_GET, 2, words[2] );
+}
+
+// polled a few frames at a time the ring wraps over and over without losing one
+static void testWrap(void) {
+  for (int n=0; n<40; n++) {
+    int frames = 1 + n % 3;
+    for (int i=0; i<frames; i++) {
+      request( TUNING_SET, 0, n*2 + i - 40 );
+    }
+    tuningPoll( &config );
+    uint8_t got[4*TUNING_FRAME], want[TUNING_FRAME];
+    size_t len = simUartTx( got, sizeof(got) );
+    CHECK( len == (size_t)frames * TUNING_FRAME, "wrap %d: %u bytes", n, (unsigned)len );
+    for (int i=0; i<frames && (size_t)(i+1)*TUNING_FRAME <= len; i++) {
+      frame( want, TUNING_REPLY, TUNING_SET, 0, n*2 + i - 40 );
+      CHECK( memcmp( got + i*TUNING_FRAME, want, TUNING_FRAME ) == 0, "wrap %d: frame %d", n, i );
+    }
+  }
+}
+
+int main(void) {
+  // what MX_LPUART1_Init() leaves for the rx dma
+  LL_DMA_SetDataTransferDirection( DMA1, LL_DMA_CHANNEL_3, LL_DMA_DIRECTION_PERIPH_TO_MEMORY );
+  LL_DMA_SetMode( DMA1, LL_DMA_CHANNEL_3, LL_DMA_MODE_CIRCULAR );
+  LL_DMA_SetMemoryIncMode( DMA1, LL_DMA_CHANNEL_3, LL_DMA_MEMORY_INCREMENT );
+  tuningStart();
+  testGetSet();
+  testCommit();
+  testSync();
+  testWrap();
+  return simDone( "test_tuning" );
+}
@@ -0,0 +1,754 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// test_wpc.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/wait.h>
+
+// the whole firmware from reset, with the wpc89 on EN and DIR played by the scenario at the
+// bottom. what main.c would trace comes here instead, the same points a board capture has
+#include "trace.h"
+static void seen(trace_t event, uint32_t arg);
+#undef TRACE
+#define TRACE(event,arg)           seen(event, arg)
+
+#define main firmware_main
+#include "../Core/Src/main.c"
+#undef main
+
+// the switch closes this far below where the carriage is at power up
+#define LIMIT_AT                   (-50000)
+#define POLL_US                    50
+#define MOVE_US                    5000000
+#define HOME_EDGES                 16
+#define LIMIT_EDGES                8
+#define REVERSALS                  40
+// into the boot seek, well above the switch
+#define SPIKE_US                   300000
+// a reset with a good resume record has HOME up this soon
+#define RESUME_READY_US            20000
+// how long a game leaves the elevator on a level between moves
+#define GAME_PAUSE_US              15000000
+// pulses a speed is taken over, four full steps at 1/32. near cruise a period is ~104
+// ticks, so one tick less is a 1% jump that over a single step would read as ~14000 steps/s/s
+#define BENCH_WINDOW               128
+
+static struct {
+    unsigned edges;               // EN and DIR edges the EXTI took
+    unsigned depth;               // queued after the last of them
+    unsigned full;                // edges that found the queue full
+    unsigned commands;            // once settled
+    wpc_t command;
+    uint64_t command_at;
+    uint64_t ready_at;            // the first HOME edge, homed and listening
+    uint64_t home_set_at;         // the first time HOME was set, an edge or not
+    unsigned homes;               // HOME edges
+    struct {
+        opto_t level;
+        int32_t carriage;
+    } home[HOME_EDGES];           // the last few, by homes % HOME_EDGES
+    uint64_t pulse_at;            // the first pulse since it was cleared
+    uint64_t last_pulse_at;
+    uint64_t flash_at;            // the last eeprom word done
+    int32_t lowest;               // the carriage
+    unsigned limits;              // switch edges acted on
+    struct {
+        homing_t homing;
+        int32_t carriage;
+    } limit[LIMIT_EDGES];
+    unsigned faults;
+    homing_t spike;               // what the seek was doing when the noise came
+    struct {
+        uint64_t at[BENCH_WINDOW];  // the last pulses of the move, by pulses % BENCH_WINDOW
+        int32_t carriage[BENCH_WINDOW];
+        double v[BENCH_WINDOW];     // steps/s over the window ending at each
+        uint32_t pulses;
+        double peak_v;
+        double peak_a;              // steps/s/s, between windows a window apart
+    } bench;
+} obs;
+
+// where the firmware's zero is on the carriage, once homed
+static int32_t zero;
+// and how far off that the carriage has slipped, until a crossing on the way down puts it back
+static int32_t slipped;
+
+static void seen(trace_t event, uint32_t arg) {
+  switch ( event ) {
+    case trace_en_dir:
+      obs.edges++;
+      // the edge before this one found it full too, so this went over it
+      obs.full += ( obs.depth == WPC_QUEUE_LEN - 1 );
+      obs.depth = (wpc_head + WPC_QUEUE_LEN - wpc_tail) % WPC_QUEUE_LEN;
+      break;
+    case trace_limit:
+      if ( obs.limits < LIMIT_EDGES ) {
+        obs.limit[ obs.limits ].homing = homing;
+        obs.limit[ obs.limits ].carriage = simCarriage();
+      }
+      obs.limits++;
+      break;
+    case trace_home:
+      if ( !obs.home_set_at ) {
+        obs.home_set_at = simTime();
+      }
+      break;
+    case trace_fault:
+      obs.faults++;
+      break;
+    case trace_command:
+      obs.commands++;
+      obs.command.enable = arg >> 1;
+      obs.command.direction = arg & 1;
+      obs.command_at = simTime();
+      break;
+    default:
+      break;
+  }
+}
+
+static void output(GPIO_TypeDef *port, uint32_t changed, uint32_t odr) {
+  if ( port != HOME_GPIO_Port || !(changed & HOME_Pin) ) {
+    return;
+  }
+  if ( !obs.homes ) {
+    obs.ready_at = simTime();
+  }
+  obs.home[ obs.homes % HOME_EDGES ].level = (odr & HOME_Pin) ? opto_open : opto_closed;
+  obs.home[ obs.homes % HOME_EDGES ].carriage = simCarriage();
+  obs.homes++;
+}
+
+static void flashed(void) {
+  obs.flash_at = simTime();
+}
+
+// speed and acceleration off the carriage, over BENCH_WINDOW pulses so the 1/4us the
+// periods are rounded to doesn't show
+static void bench(void) {
+  if ( !obs.pulse_at ) {
+    obs.bench.pulses = 0;
+    obs.bench.peak_v = 0;
+    obs.bench.peak_a = 0;
+  }
+  unsigned n = obs.bench.pulses++ , k = n % BENCH_WINDOW;
+  uint64_t at = simTime();
+  int32_t c = simCarriage();
+  double v = 0;
+  if ( n >= BENCH_WINDOW ) {
+    v = fabs( (double)(c - obs.bench.carriage[k]) / USTEPS_PER_STEP ) * SIM_US(1000000) / (at - obs.bench.at[k]);
+    if ( v > obs.bench.peak_v ) {
+      obs.bench.peak_v = v;
+    }
+    if ( n >= 2 * BENCH_WINDOW ) {
+      // the window before this one ended where this one began
+      double a = fabs( v - obs.bench.v[k] ) * SIM_US(1000000) / (at - obs.bench.at[k]);
+      if ( a > obs.bench.peak_a ) {
+        obs.bench.peak_a = a;
+      }
+    }
+  }
+  obs.bench.at[k] = at;
+  obs.bench.carriage[k] = c;
+  obs.bench.v[k] = v;
+}
+
+static void stepped(void) {
+  bench();
+  if ( !obs.pulse_at ) {
+    obs.pulse_at = simTime();
+  }
+  obs.last_pulse_at = simTime();
+  if ( simCarriage() < obs.lowest ) {
+    obs.lowest = simCarriage();
+  }
+}
+
+// main.c spins on these two with nothing touching a register, the board sits out the pulses
+// or the flash there but here time only goes by when asked. linked in with --wrap
+void __real_stepperWait(void);
+bool __real_eeBusy(void);
+
+void __wrap_stepperWait(void) {
+  while ( stepperBusy() ) {
+    simWait();
+  }
+}
+
+bool __wrap_eeBusy(void) {
+  bool busy = __real_eeBusy();
+  if ( busy ) {
+    simWait();
+  }
+  return busy;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// the scenario runs on its own stack from script events, so it reads straight through while
+// the firmware's main() never returns. after() hands the time back to the firmware
+
+static ucontext_t firmware, scenario;
+static char scenario_stack[1 << 16];
+
+static void resume(void) {
+  swapcontext( &firmware, &scenario );
+}
+
+static void after(uint32_t us) {
+  simAt( simTime() + SIM_US(us), resume );
+  swapcontext( &scenario, &firmware );
+}
+
+// poll for cond, false if it didn't come true in time
+#define UNTIL(cond, us) \
+  ({ uint64_t until_ = simTime() + SIM_US(us); \
+     while ( !(cond) && simTime() < until_ ) after( POLL_US ); \
+     (cond); })
+
+// the wpc89's outputs, EN is active low
+static void driveEn(bool on) {
+  simPin( EN_GPIO_Port, EN_Pin, !on );
+}
+
+static void driveDir(motor_dir_t dir) {
+  simPin( DIR_GPIO_Port, DIR_Pin, dir == motor_dir_cw );
+}
+
+// a flick of the switch too short to still read closed once the EXTI gets to it
+static void spike(void) {
+  obs.spike = homing;
+  simPin( LIMIT_GPIO_Port, LIMIT_Pin, true );
+  simPin( LIMIT_GPIO_Port, LIMIT_Pin, false );
+}
+
+static void enOn(void)   { driveEn( true ); }
+static void enOff(void)  { driveEn( false ); }
+static void dirCw(void)  { driveDir( motor_dir_cw ); }
+static void dirCcw(void) { driveDir( motor_dir_ccw ); }
+
+static int32_t carriage(void) {
+  return simCarriage() - zero;
+}
+
+static bool isCamEdge(cam_side_t side, int32_t at) {
+  return at == config.cam_edges[ side ][ 0 ] || at == config.cam_edges[ side ][ 1 ];
+}
+
+// what the wpc89 does for a level: DIR, EN a moment later, and EN off again as soon as the
+// move has settled, before the elevator goes round again. then HOME has to have left its
+// rest once at a cam edge and come back on arrival, with the count still on the carriage
+static void runLevel(const char *what, motor_dir_t dir) {
+  level_t from = current_level;
+  level_t want = transitions[ dir ][ from ];
+  cam_side_t side = ( from == level_mid_r || want == level_mid_r ) ? cam_right : cam_left;
+  bool turn = ( dir != cam_direction );
+  unsigned commands = obs.commands, homes = obs.homes;
+  obs.pulse_at = 0;
+
+  driveDir( dir );
+  after( 4 );
+  driveEn( true );
+  CHECK( UNTIL( motion == motion_settling, MOVE_US ), "%s: never arrived", what );
+  driveEn( false );
+  CHECK( UNTIL( motion == motion_idle && obs.commands == commands + 2, 100000 ), "%s: never settled", what );
+
+  CHECK( obs.commands == commands + 2, "%s: %u commands", what, obs.commands - commands );
+  CHECK( current_level == want, "%s: at level %d not %d", what, current_level, want );
+  CHECK( stepperPosition() == levelPosition( want ) && carriage() == levelPosition( want ),
+         "%s: count %d, carriage %d, level at %d", what, (int)stepperPosition(), (int)carriage(),
+         (int)levelPosition( want ) );
+  unsigned edges = obs.homes - homes;
+  CHECK( edges == 2u + turn, "%s: HOME changed %u times", what, edges );
+  if ( edges >= 2 ) {
+    unsigned last = (obs.homes - 1) % HOME_EDGES, mid = (obs.homes - 2) % HOME_EDGES;
+    CHECK( obs.home[ mid ].level != optoAtRest( dir ) && isCamEdge( side, obs.home[ mid ].carriage - zero - slipped ),
+           "%s: HOME to %d at %d", what, obs.home[ mid ].level, (int)(obs.home[ mid ].carriage - zero - slipped) );
+    CHECK( obs.home[ last ].level == optoAtRest( dir ) && obs.home[ last ].carriage - zero == levelPosition( want ),
+           "%s: HOME back to %d at %d", what, obs.home[ last ].level, (int)(obs.home[ last ].carriage - zero) );
+  }
+  CHECK( LL_GPIO_IsOutputPinSet( HOME_GPIO_Port, HOME_Pin ) == optoAtRest( dir ), "%s: HOME at rest", what );
+}
+
+// each of the four level moves against the profile: the peak speed and acceleration off
+// the carriage within the configured limits, and the time no longer than the s-curve from
+// the start speed to the cruise and back takes over the same distance
+static void testBench(void) {
+  for (int i=0; i<4; i++) {
+    level_t from = current_level, to = transitions[ motor_dir_cw ][ from ];
+    char what[32];
+    snprintf( what, sizeof(what), "bench %d to %d", from, to );
+    runLevel( what, motor_dir_cw );
+    double steps = (double)abs( levelPosition( to ) - levelPosition( from ) ) / USTEPS_PER_STEP;
+    // smoothstep peaks at 1.5 times its mean acceleration
+    double ramp_s = 1.5 * (config.speed - config.start) / config.accel;
+    double ramp_steps = (config.speed + config.start) / 2.0 * ramp_s;
+    double ideal_s = 2 * ramp_s + (steps - 2 * ramp_steps) / config.speed;
+    double took_s = (double)(obs.last_pulse_at - obs.pulse_at) / SIM_US(1000000);
+    printf( "%s: %.0f steps in %.1fms (s-curve %.1fms), peak %.0f steps/s of %u, %.0f steps/s/s of %u\n", what,
+            steps, took_s * 1000, ideal_s * 1000, obs.bench.peak_v, (unsigned)config.speed, obs.bench.peak_a,
+            (unsigned)config.accel );
+    CHECK( obs.bench.peak_v <= config.speed * 1.01 && obs.bench.peak_v >= config.speed * 0.99,
+           "%s: peak %.0f steps/s", what, obs.bench.peak_v );
+    CHECK( obs.bench.peak_a <= config.accel * 1.05, "%s: peak %.0f steps/s/s", what, obs.bench.peak_a );
+    CHECK( took_s <= ideal_s * 1.02, "%s: took %.1fms", what, took_s * 1000 );
+  }
+}
+
+// the seek runs down fast, ignores the noise on the way and ramps down past the switch, the
+// back off clears it and the approach stops on the first contact, which is zero. all in a
+// fraction of the time the old 1/8 step seek at STEP_PERIOD took to cover the same ground
+static void testBoot(void) {
+  // the ramp down from the seek speed, and the ring half already planned when the edge came
+  int32_t overrun = ( HOMING_SEEK_SPEED * HOMING_SEEK_SPEED / (2 * STEP_ACCEL) + 2 ) * USTEPS_PER_STEP;
+  uint64_t old_us = (uint64_t)-LIMIT_AT / (USTEPS_PER_STEP / 8) * (STEP_SIZE * 2);
+  CHECK( obs.spike == homing_seek, "boot: the spike came with homing %d", obs.spike );
+  CHECK( obs.limits == 2 && obs.limit[0].homing == homing_seek && obs.limit[1].homing == homing_approach,
+         "boot: %u switch edges, homing %d then %d", obs.limits, obs.limit[0].homing, obs.limit[1].homing );
+  CHECK( obs.limit[0].carriage == LIMIT_AT && obs.limit[1].carriage == LIMIT_AT,
+         "boot: switch at %d and %d", (int)obs.limit[0].carriage, (int)obs.limit[1].carriage );
+  CHECK( obs.lowest >= LIMIT_AT - overrun, "boot: ran %d past the switch", (int)(LIMIT_AT - obs.lowest) );
+  CHECK( zero <= LIMIT_AT && zero > LIMIT_AT - USTEPS_PER_STEP / 8, "boot: zero at %d", (int)zero );
+  CHECK( limit_known && limit_ref == 0, "boot: limit at %d", (int)limit_ref );
+  CHECK( current_level == level_down && cam_direction == motor_dir_cw &&
+         LL_GPIO_IsOutputPinSet( HOME_GPIO_Port, HOME_Pin ) == opto_open, "boot: level %d, turning %d",
+         current_level, cam_direction );
+  CHECK( obs.ready_at < SIM_US(old_us / 3), "boot: ready after %llums, the old seek took %llums",
+         (unsigned long long)(obs.ready_at / SIM_US(1000)), (unsigned long long)(old_us / 1000) );
+}
+
+// the wpc89 changing its mind part way through a level, at points spread over the whole
+// move, one for each of the four it could be making in turn. whether it stops short or has
+// just got there, it ends back where it started with one command for the turn, HOME at
+// rest the new way and every pulse put out still on the count
+static void testReverse(void) {
+  runLevel( "reverse timing", motor_dir_cw );
+  uint64_t move = obs.last_pulse_at - obs.pulse_at;
+  uint32_t seed = 1;
+  char what[32];
+  for (int i=0; i<REVERSALS; i++) {
+    seed = seed * 1103515245 + 12345;
+    unsigned percent = 1 + (seed >> 16) % 99;
+    snprintf( what, sizeof(what), "reverse %d at %u%%", i, percent );
+    level_t from = current_level;
+    unsigned commands = obs.commands;
+    obs.pulse_at = 0;
+    driveDir( motor_dir_cw );
+    after( 4 );
+    driveEn( true );
+    CHECK( UNTIL( obs.pulse_at, 10000 ), "%s: no pulse", what );
+    uint64_t at = obs.pulse_at + move * percent / 100;
+    if ( at > simTime() ) {
+      after( (at - simTime()) / SIM_TICKS_PER_US );
+    }
+    driveDir( motor_dir_ccw );
+    CHECK( UNTIL( motion == motion_settling && current_level == from, 2 * MOVE_US ), "%s: never back", what );
+    driveEn( false );
+    UNTIL( motion == motion_idle && obs.commands == commands + 3, 100000 );
+    CHECK( obs.commands == commands + 3, "%s: %u commands", what, obs.commands - commands );
+    CHECK( current_level == from && cam_direction == motor_dir_ccw, "%s: at %d turning %d, from %d", what,
+           current_level, cam_direction, from );
+    CHECK( stepperPosition() == levelPosition( from ) && carriage() == levelPosition( from ),
+           "%s: count %d, carriage %d, level at %d", what, (int)stepperPosition(), (int)carriage(),
+           (int)levelPosition( from ) );
+    CHECK( LL_GPIO_IsOutputPinSet( HOME_GPIO_Port, HOME_Pin ) == optoAtRest( motor_dir_ccw ), "%s: HOME at rest", what );
+    // on round to the next one
+    runLevel( what, motor_dir_cw );
+  }
+}
+
+// steps lost on the way, the switch puts them back. with down right on it every move there
+// crosses it on the last pulse, and slipped low the crossing comes early and is corrected
+// on the way. slipped high none do, until the check every DRIFT_CHECK_MOVES moves down runs
+// on past it. no other move runs past down
+static void testDrift(void) {
+  int32_t slip = 2 * USTEPS_PER_STEP;
+  while ( transitions[ motor_dir_cw ][ current_level ] != level_down || unchecked == DRIFT_CHECK_MOVES - 1 ) {
+    runLevel( "drift", motor_dir_cw );
+  }
+  simSlip( -slip );
+  slipped = -slip;
+  obs.lowest = INT32_MAX;
+  runLevel( "drift low", motor_dir_cw );
+  slipped = 0;
+  CHECK( obs.lowest >= zero - slip && unchecked == 0, "drift low: ran %d past down, %u unchecked",
+         (int)(zero - obs.lowest), unchecked );
+
+  // nothing puts it back until the check, so the levels are where the count has them
+  simSlip( slip );
+  zero += slip;
+  char what[32];
+  for (int i=1; i<DRIFT_CHECK_MOVES; i++) {
+    snprintf( what, sizeof(what), "drift high %d", i );
+    obs.lowest = INT32_MAX;
+    for (int j=0; j<4; j++) {
+      runLevel( what, motor_dir_cw );
+    }
+    CHECK( obs.lowest >= zero && unchecked == i, "%s: ran %d past down, %u unchecked", what,
+           (int)(zero - obs.lowest), unchecked );
+  }
+  runLevel( "drift high", motor_dir_cw );
+  runLevel( "drift high", motor_dir_cw );
+  runLevel( "drift high", motor_dir_cw );
+  zero -= slip;
+  slipped = slip;
+  obs.lowest = INT32_MAX;
+  runLevel( "drift check", motor_dir_cw );
+  slipped = 0;
+  CHECK( obs.lowest < zero && unchecked == 0, "drift check: ran %d past down, %u unchecked",
+         (int)(zero - obs.lowest), unchecked );
+}
+
+// a fault part way up a level, the driver is reset and homed again from there. zero comes
+// out where it did at boot and the levels carry on from it
+static void testFault(void) {
+  unsigned limits = obs.limits, faults = obs.faults;
+  driveDir( motor_dir_cw );
+  after( 4 );
+  driveEn( true );
+  after( 300000 );
+  CHECK( motion == motion_moving, "fault: not moving" );
+  simPin( S_NFLT_GPIO_Port, S_NFLT_Pin, false );
+  after( 10 );
+  simPin( S_NFLT_GPIO_Port, S_NFLT_Pin, true );
+  driveEn( false );
+  obs.lowest = INT32_MAX;
+  CHECK( UNTIL( !fault && !fault_tries && homing == homing_off && !stepperBusy(), 30000000 ), "fault: never recovered" );
+  after( 1000 );
+  int32_t rezero = simCarriage() - stepperPosition();
+  CHECK( obs.faults == faults + 1, "fault: %u faults", obs.faults - faults );
+  CHECK( obs.limits == limits + 2, "fault: %u switch edges", obs.limits - limits );
+  CHECK( rezero == zero, "fault: zero at %d, was %d", (int)rezero, (int)zero );
+  CHECK( current_level == level_down && stepperPosition() == 0 && derate == 1, "fault: level %d at %d, derate %d",
+         current_level, (int)stepperPosition(), derate );
+  zero = rezero;
+  runLevel( "fault cw", motor_dir_cw );
+  runLevel( "fault ccw", motor_dir_ccw );
+}
+
+// the lines wiggling for less than WPC_SETTLE_US is the 6809 writing its port, not a command
+static void testGlitch(void) {
+  unsigned commands = obs.commands, edges = obs.edges;
+  uint32_t pulses = simPulses();
+  driveEn( true );
+  after( WPC_SETTLE_US / 2 );
+  driveEn( false );
+  after( 1000 );
+  driveDir( motor_dir_ccw );
+  after( WPC_SETTLE_US - 2 );
+  driveDir( motor_dir_cw );
+  after( 1000 );
+  // both at once, and back in the opposite order
+  driveEn( true );
+  driveDir( motor_dir_ccw );
+  after( 3 );
+  driveDir( motor_dir_cw );
+  after( 3 );
+  driveEn( false );
+  after( 50000 );
+  CHECK( obs.edges == edges + 8, "glitch: %u edges", obs.edges - edges );
+  CHECK( obs.commands == commands, "glitch: %u commands", obs.commands - commands );
+  CHECK( simPulses() == pulses && motion == motion_idle, "glitch: moved %u pulses",
+         (unsigned)(simPulses() - pulses) );
+}
+
+// a command starts the move straight away, the settle window and the direction setup
+// time are all that's between the last edge and the first pulse
+static void testRespond(void) {
+  unsigned commands = obs.commands;
+  obs.pulse_at = 0;
+  uint64_t edge = simTime();
+  driveEn( true );
+  CHECK( UNTIL( obs.pulse_at, 10000 ), "respond: no pulse" );
+  CHECK( obs.commands == commands + 1 && obs.command_at - edge >= SIM_US(WPC_SETTLE_US),
+         "respond: command %lluus after the edge", (unsigned long long)((obs.command_at - edge) / SIM_TICKS_PER_US) );
+  CHECK( obs.pulse_at - edge < SIM_US(100), "respond: first pulse %lluus after the edge",
+         (unsigned long long)((obs.pulse_at - edge) / SIM_TICKS_PER_US) );
+  CHECK( UNTIL( motion == motion_settling, MOVE_US ), "respond: never arrived" );
+  driveEn( false );
+  UNTIL( motion == motion_idle, 100000 );
+}
+
+// the loop only drains the queue between jobs, the longest of which is the coils coming
+// back. edges all through that fill it and the newest goes over the last, so the lines as
+// they end up are still what's acted on, and only once
+static void testOverflow(void) {
+  CHECK( UNTIL( !energised, HOLD_RELEASE_MS * 1000 + 1000000 ), "overflow: driver never released" );
+  level_t from = current_level;
+  driveDir( motor_dir_ccw );
+  after( 4 );
+  unsigned commands = obs.commands, edges = obs.edges;
+  driveEn( true );
+  CHECK( UNTIL( energised, 10000 ), "overflow: driver never enabled" );
+  obs.full = 0;
+  uint64_t at = simTime();
+  int n = 0;
+  for (int i=0; i<WPC_QUEUE_LEN; i++) {
+    simAt( at + SIM_US(2*n++), dirCw );
+    simAt( at + SIM_US(2*n++), enOff );
+    simAt( at + SIM_US(2*n++), dirCcw );
+    simAt( at + SIM_US(2*n++), enOn );
+  }
+  CHECK( UNTIL( motion == motion_settling, MOVE_US ), "overflow: never arrived" );
+  driveEn( false );
+  UNTIL( motion == motion_idle, 100000 );
+  CHECK( obs.edges == edges + n + 2, "overflow: %u edges", obs.edges - edges );
+  CHECK( obs.full > 0, "overflow: the queue never filled" );
+  CHECK( obs.commands == commands + 2, "overflow: %u commands", obs.commands - commands );
+  CHECK( current_level == transitions[ motor_dir_ccw ][ from ] && cam_direction == motor_dir_ccw,
+         "overflow: at %d turning %d", current_level, cam_direction );
+  CHECK( carriage() == stepperPosition(), "overflow: carriage %d, count %d", (int)carriage(),
+         (int)stepperPosition() );
+}
+
+// left long enough the driver lets go and the clocks stop, an edge still wakes it and the
+// move goes once the coils are back, after the resume record is cleared
+static void testWake(void) {
+  CHECK( UNTIL( !energised && (SCB->SCR & SCB_SCR_SLEEPDEEP_Msk), HOLD_RELEASE_MS * 1000 + 1000000 ),
+         "wake: never stopped" );
+  uint32_t pulses = simPulses();
+  after( 500000 );
+  CHECK( simPulses() == pulses && !energised, "wake: moved while stopped" );
+  uint64_t edge = simTime();
+  runLevel( "wake", motor_dir_cw );
+  uint64_t ready = ( obs.flash_at > edge ) ? obs.flash_at : edge;
+  CHECK( obs.pulse_at - ready < SIM_US(ENERGISE_US + 100), "wake: first pulse %lluus after the edge, %lluus after the eeprom",
+         (unsigned long long)((obs.pulse_at - edge) / SIM_TICKS_PER_US),
+         (unsigned long long)((obs.pulse_at - ready) / SIM_TICKS_PER_US) );
+}
+
+// a fine adjustment button held down for us, they're active low
+static void button(input_id_t id, uint32_t us) {
+  uint32_t pin = ( id == input_right ) ? SW1_Pin : SW0_Pin;
+  simPin( SW0_GPIO_Port, pin, false );
+  after( us );
+  simPin( SW0_GPIO_Port, pin, true );
+}
+
+// taps, each moving down a step straight away with the count left where it was so the
+// levels go with it, and the run of them saved once, PRESS_COMMIT_MS after the last
+static void tapRun(const char *what, const input_id_t *taps, unsigned n) {
+  config_t saved;
+  int32_t steps = config.press_steps, position = stepperPosition(), at = simCarriage(), net = 0;
+  CHECK( UNTIL( !eeBusy(), 100000 ), "%s: eeprom busy", what );
+  CHECK( !configLoad( &saved ) || saved.press_steps == steps, "%s: saved %d", what, (int)saved.press_steps );
+  uint64_t released = 0;
+  for (unsigned i=0; i<n; i++) {
+    net += ( taps[i] == input_right ) ? 1 : -1;
+    button( taps[i], 100000 );
+    released = simTime();
+    CHECK( UNTIL( motion == motion_idle && !stepperBusy() && simCarriage() == at + net * USTEPS_PER_STEP, 100000 ),
+           "%s: tap %u moved %d", what, i, (int)(simCarriage() - at) );
+    CHECK( stepperPosition() == position && config.press_steps == steps + net, "%s: tap %u count %d, press_steps %d",
+           what, i, (int)stepperPosition(), (int)config.press_steps );
+    after( 1000000 );
+  }
+
+  // the release is taken once it's debounced, so a moment after the pin went
+  after( PRESS_COMMIT_MS * 1000 - (simTime() - released) / SIM_TICKS_PER_US - 20000 );
+  CHECK( !configLoad( &saved ) || saved.press_steps == steps, "%s: saved %d before PRESS_COMMIT_MS", what,
+         (int)saved.press_steps );
+  CHECK( UNTIL( configLoad( &saved ) && saved.press_steps == steps + net && !eeBusy(), 100000 ),
+         "%s: saved %d", what, (int)saved.press_steps );
+  CHECK( memcmp( &saved, &config, sizeof(saved) ) == 0, "%s: saved config differs", what );
+  zero += net * USTEPS_PER_STEP;
+}
+
+// taps away from down, a hold each way with the move down checking the count on the switch,
+// which has to find it where the taps moved it, a round of levels from there and taps back
+static void testButtons(void) {
+  static const input_id_t out[] = { input_right, input_right, input_left, input_right };
+  static const input_id_t back[] = { input_left, input_left };
+  while ( current_level != level_down ) {
+    runLevel( "buttons", motor_dir_cw );
+  }
+  tapRun( "taps", out, sizeof(out)/sizeof(out[0]) );
+
+  unchecked = DRIFT_CHECK_MOVES - 1;
+  button( input_right, INPUT_LONG_MS * 1000 + 100000 );
+  CHECK( UNTIL( motion == motion_idle && !stepperBusy(), MOVE_US ), "hold: never arrived" );
+  CHECK( current_level == transitions[ motor_dir_cw ][ level_down ] && carriage() == levelPosition( current_level ),
+         "hold: to level %d, carriage %d", current_level, (int)carriage() );
+  unsigned limits = obs.limits;
+  button( input_left, INPUT_LONG_MS * 1000 + 100000 );
+  CHECK( UNTIL( motion == motion_idle && !stepperBusy(), MOVE_US ), "hold: never arrived" );
+  CHECK( current_level == level_down && obs.limits > limits, "hold: to level %d, %u switch edges", current_level,
+         obs.limits - limits );
+  CHECK( stepperPosition() == levelPosition( level_down ) && carriage() == levelPosition( level_down ),
+         "hold: count %d, carriage %d", (int)stepperPosition(), (int)carriage() );
+  for (int i=0; i<4; i++) {
+    runLevel( "buttons", motor_dir_cw );
+  }
+  tapRun( "taps back", back, sizeof(back)/sizeof(back[0]) );
+}
+
+// a game's worth of moves with pauses between writes nothing but the clear of the last
+// save, the position only goes in again once the elevator's been left for POSITION_SAVE_MS
+static void testSaves(void) {
+  while ( current_level != level_down ) {
+    runLevel( "saves", motor_dir_cw );
+  }
+  CHECK( UNTIL( resume_saved && !eeBusy(), POSITION_SAVE_MS * 1000 + 100000 ), "saves: never saved" );
+  uint32_t words = simFlashWords;
+  for (int i=0; i<8; i++) {
+    runLevel( "saves", ( i & 4 ) ? motor_dir_ccw : motor_dir_cw );
+    after( GAME_PAUSE_US );
+  }
+  CHECK( simFlashWords == words + 1, "saves: %u words for 8 moves", simFlashWords - words );
+  words = simFlashWords;
+  CHECK( UNTIL( resume_saved && !eeBusy(), POSITION_SAVE_MS * 1000 ), "saves: never saved" );
+  // a position, its check and the mark
+  CHECK( simFlashWords == words + 3, "saves: %u words for the save", simFlashWords - words );
+}
+
+// the warm boots below fork off before the firmware has run, so they come up from reset,
+// and wait here for what the power leaves behind. one finds the carriage where the record
+// has it, one finds it turned a level by hand since
+typedef struct {
+    sim_plant_t plant;
+    int32_t zero;
+} reboot_t;
+
+static void runResume(void);
+static void runMoved(void);
+
+static struct {
+    const char *name;
+    void (*run)(void);
+    int32_t moved;
+    int fd;
+    pid_t pid;
+} reboots[] = {
+  { "test_wpc resume", runResume, 0 },
+  { "test_wpc moved", runMoved, USTEPS_PER_LEVEL },
+};
+
+#define REBOOTS                    (sizeof(reboots) / sizeof(reboots[0]))
+
+// the power goes with the resume record in and the carriage sat on down
+static void testReboot(void) {
+  reboot_t off;
+  simPlant( &off.plant );
+  off.zero = zero;
+  for (unsigned i=0; i<REBOOTS; i++) {
+    reboot_t r = off;
+    r.plant.carriage += reboots[i].moved;
+    fflush( stdout );
+    CHECK( write( reboots[i].fd, &r, sizeof(r) ) == sizeof(r), "%s: not handed over", reboots[i].name );
+    close( reboots[i].fd );
+    int status;
+    waitpid( reboots[i].pid, &status, 0 );
+    CHECK( WIFEXITED( status ) && WEXITSTATUS( status ) == 0, "%s: exit %#x", reboots[i].name, status );
+  }
+}
+
+// HOME may already be where it's left out of reset, so ready is once main.c first sets it.
+// straight away without homing, at the position the rotor was pulled round to, and the
+// first move down finds the switch again
+static void runResume(void) {
+  CHECK( UNTIL( obs.home_set_at, 30000000 ), "resume: never ready" );
+  CHECK( obs.home_set_at < SIM_US(RESUME_READY_US), "resume: ready after %lluus",
+         (unsigned long long)(obs.home_set_at / SIM_TICKS_PER_US) );
+  CHECK( obs.limits == 0 && simPulses() == 0, "resume: %u switch edges, %u pulses", obs.limits, simPulses() );
+  CHECK( current_level == level_down && !limit_known &&
+         LL_GPIO_IsOutputPinSet( HOME_GPIO_Port, HOME_Pin ) == optoAtRest( cam_direction ),
+         "resume: level %d, turning %d", current_level, cam_direction );
+  CHECK( simCarriage() - stepperPosition() == zero, "resume: zero at %d, was %d",
+         (int)(simCarriage() - stepperPosition()), (int)zero );
+  for (int i=0; i<4; i++) {
+    runLevel( "resume", motor_dir_cw );
+  }
+  CHECK( limit_known && abs( limit_ref ) < USTEPS_PER_STEP / 8, "resume: limit at %d", (int)limit_ref );
+  exit( simDone( reboots[0].name ) );
+}
+
+// the switch doesn't read the way it was saved, so it's a full homing from wherever it is,
+// onto the same switch within the 1/8 step the approach finds it to
+static void runMoved(void) {
+  CHECK( UNTIL( obs.home_set_at, 30000000 ), "moved: never homed" );
+  CHECK( obs.home_set_at >= SIM_US(RESUME_READY_US) && obs.limits == 2, "moved: ready after %lluus, %u switch edges",
+         (unsigned long long)(obs.home_set_at / SIM_TICKS_PER_US), obs.limits );
+  int32_t rezero = simCarriage() - stepperPosition();
+  CHECK( current_level == level_down && limit_known && rezero <= LIMIT_AT && rezero > LIMIT_AT - USTEPS_PER_STEP / 8,
+         "moved: level %d, zero at %d", current_level, (int)rezero );
+  CHECK( LL_GPIO_IsOutputPinSet( HOME_GPIO_Port, HOME_Pin ) == optoAtRest( cam_direction ), "moved: HOME at rest" );
+  exit( simDone( reboots[1].name ) );
+}
+
+static void run(void) {
+  CHECK( UNTIL( obs.ready_at, 30000000 ), "boot: never homed" );
+  zero = simCarriage() - stepperPosition();
+
+  testBoot();
+  testGlitch();
+  testBench();
+  // round the cam both ways
+  runLevel( "cw 1", motor_dir_cw );
+  runLevel( "cw 2", motor_dir_cw );
+  runLevel( "cw 3", motor_dir_cw );
+  runLevel( "cw 4", motor_dir_cw );
+  runLevel( "ccw 1", motor_dir_ccw );
+  runLevel( "ccw 2", motor_dir_ccw );
+  runLevel( "cw 5", motor_dir_cw );
+  testRespond();
+  testWake();
+  testOverflow();
+  testReverse();
+  testDrift();
+  testFault();
+  testButtons();
+  testSaves();
+  testReboot();
+
+  exit( simDone( "test_wpc" ) );
+}
+
+static int boot(void (*scenario_fn)(void)) {
+  simOutput = output;
+  simStep = stepped;
+  simFlashDone = flashed;
+  obs.lowest = INT32_MAX;
+  getcontext( &scenario );
+  scenario.uc_stack.ss_sp = scenario_stack;
+  scenario.uc_stack.ss_size = sizeof(scenario_stack);
+  makecontext( &scenario, scenario_fn, 0 );
+  simAt( 0, resume );
+  firmware_main();
+  return 1;
+}
+
+int main(void) {
+  for (unsigned i=0; i<REBOOTS; i++) {
+    int fds[2];
+    if ( pipe( fds ) ) {
+      perror( "test_wpc: pipe" );
+      return 2;
+    }
+    pid_t pid = fork();
+    if ( pid == 0 ) {
+      for (unsigned j=0; j<i; j++) {
+        close( reboots[j].fd );
+      }
+      close( fds[1] );
+      reboot_t r;
+      if ( read( fds[0], &r, sizeof(r) ) != sizeof(r) ) {
+        // the cold boot never got that far, and has said why
+        _exit( 0 );
+      }
+      simPowerUp( &r.plant );
+      zero = r.zero;
+      return boot( reboots[i].run );
+    }
+    close( fds[0] );
+    reboots[i].fd = fds[1];
+    reboots[i].pid = pid;
+  }
+  simLimit( LIMIT_AT );
+  simAt( SIM_US(SPIKE_US), spike );
+  return boot( run );
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// trace_decode.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+#include "trace_decode.h"
+
+enum {
+    part_code = 0,
+    part_delta = 1,
+    part_arg = 2
+};
+
+static const char *const names[] = {
+    [trace_start] = "start",
+    [trace_lost] = "lost",
+    [trace_run] = "run",
+    [trace_refill] = "refill",
+    [trace_decel] = "decel",
+    [trace_done] = "done",
+    [trace_home] = "home",
+    [trace_en_dir] = "en_dir",
+    [trace_command] = "command",
+    [trace_limit] = "limit",
+    [trace_fault] = "fault",
+    [trace_limit_level] = "limit_level",
+};
+
+void traceDecodeInit(trace_decoder_t *d) {
+  d->us = 0;
+  d->part = part_code;
+  d->shift = 0;
+  d->value = 0;
+}
+
+bool traceDecode(trace_decoder_t *d, uint8_t byte, trace_record_t *record) {
+  if ( d->part == part_code ) {
+    d->record.event = byte;
+    d->part = part_delta;
+    return false;
+  }
+  // a uint32_t is at most 5 groups of 7, anything past that is dropped
+  if ( d->shift < 32 ) {
+    d->value |= (uint32_t)(byte & 0x7F) << d->shift;
+  }
+  d->shift += 7;
+  if ( byte & 0x80 ) {
+    return false;
+  }
+  uint32_t v = d->value;
+  d->value = 0;
+  d->shift = 0;
+  if ( d->part == part_delta ) {
+    d->us += v;
+    d->record.us = d->us;
+    d->part = part_arg;
+    return false;
+  }
+  d->record.arg = v;
+  d->part = part_code;
+  *record = d->record;
+  return true;
+}
+
+const char *traceName(trace_t event) {
+  return ( (unsigned)event < sizeof(names)/sizeof(names[0]) ) ? names[event] : NULL;
+}
@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// trace_decode.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TRACE_DECODE_H
+#define __TRACE_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace.h"
+
+// the USART2 event stream back into events, a byte at a time so it can follow a serial
+// port as well as a file. us is the running sum of the deltas, micros() on the board
+// once the stream started from its trace_start
+
+typedef struct {
+    uint32_t us;
+    trace_t event;
+    uint32_t arg;
+} trace_record_t;
+
+typedef struct {
+    uint32_t us;
+    uint8_t part;         // code, delta or arg next
+    uint8_t shift;
+    uint32_t value;
+    trace_record_t record;
+} trace_decoder_t;
+
+void traceDecodeInit(trace_decoder_t *d);
+// true when byte finished an event, which is then in *record
+bool traceDecode(trace_decoder_t *d, uint8_t byte, trace_record_t *record);
+// the event's name, or NULL for a code the firmware doesn't send
+const char *traceName(trace_t event);
+// undo TRACE_ZIGZAG()
+#define TRACE_UNZIGZAG(v)          ((int32_t)(((uint32_t)(v) >> 1) ^ -((uint32_t)(v) & 1)))
+
+#endif // __TRACE_DECODE_H
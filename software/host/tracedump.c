@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tracedump.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace_decode.h"
+
+// tracedump [file], the raw USART2 bytes from a file or stdin as a timeline, then how long
+// the steps from a WPC edge to the end of the move it started took
+
+typedef struct {
+    const char *name;
+    unsigned count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} latency_t;
+
+static latency_t settle = { "edge to command" };
+static latency_t respond = { "command to run" };
+static latency_t moving = { "run to done" };
+static latency_t stopping = { "decel to done" };
+
+static void add(latency_t *l, uint32_t from, uint32_t to) {
+  uint32_t us = to - from;
+  if ( !l->count || us < l->min ) {
+    l->min = us;
+  }
+  if ( !l->count || us > l->max ) {
+    l->max = us;
+  }
+  l->count++;
+  l->total += us;
+}
+
+static void report(const latency_t *l) {
+  if ( l->count ) {
+    printf( "%-16s %6u  min %8u  mean %8u  max %8u us\n", l->name, l->count, (unsigned)l->min,
+            (unsigned)(l->total / l->count), (unsigned)l->max );
+  } else {
+    printf( "%-16s %6u\n", l->name, 0 );
+  }
+}
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  if ( argc > 2 ) {
+    fprintf( stderr, "usage: %s [file]\n", argv[0] );
+    return 2;
+  }
+  if ( argc == 2 && !(in = fopen( argv[1], "rb" )) ) {
+    perror( argv[1] );
+    return 1;
+  }
+
+  trace_decoder_t d;
+  trace_record_t r;
+  traceDecodeInit( &d );
+  // when each step towards a move last happened, 0 for not since the last one
+  uint32_t edge = 0, command = 0, run = 0, decel = 0;
+  bool have_edge = false, have_command = false, have_run = false, have_decel = false;
+  unsigned lost = 0;
+  int c;
+  while ( (c = getc( in )) != EOF ) {
+    if ( !traceDecode( &d, c, &r ) ) {
+      continue;
+    }
+    const char *name = traceName( r.event );
+    printf( "%10u.%03u  ", (unsigned)(r.us / 1000), (unsigned)(r.us % 1000) );
+    if ( !name ) {
+      printf( "?%-10u %u\n", (unsigned)r.event, (unsigned)r.arg );
+      continue;
+    }
+    switch ( r.event ) {
+      case trace_done:
+      case trace_limit:
+        printf( "%-11s %d\n", name, (int)TRACE_UNZIGZAG( r.arg ) );
+        break;
+      case trace_en_dir:
+      case trace_command:
+        printf( "%-11s EN %u DIR %u\n", name, (unsigned)(r.arg >> 1) & 1, (unsigned)r.arg & 1 );
+        break;
+      default:
+        printf( "%-11s %u\n", name, (unsigned)r.arg );
+        break;
+    }
+
+    switch ( r.event ) {
+      case trace_lost:
+        // whatever was in flight can't be timed
+        lost += r.arg;
+        have_edge = have_command = have_run = have_decel = false;
+        break;
+      case trace_en_dir:
+        if ( !have_edge ) {
+          edge = r.us;
+          have_edge = true;
+        }
+        break;
+      case trace_command:
+        if ( have_edge ) {
+          add( &settle, edge, r.us );
+          have_edge = false;
+        }
+        command = r.us;
+        have_command = true;
+        break;
+      case trace_run:
+        if ( have_command ) {
+          add( &respond, command, r.us );
+          have_command = false;
+        }
+        run = r.us;
+        have_run = true;
+        have_decel = false;
+        break;
+      case trace_decel:
+        if ( !have_decel ) {
+          decel = r.us;
+          have_decel = true;
+        }
+        break;
+      case trace_done:
+        if ( have_run ) {
+          add( &moving, run, r.us );
+        }
+        if ( have_decel ) {
+          add( &stopping, decel, r.us );
+        }
+        have_run = have_decel = false;
+        break;
+      default:
+        break;
+    }
+  }
+
+  printf( "\n" );
+  report( &settle );
+  report( &respond );
+  report( &moving );
+  report( &stopping );
+  if ( lost ) {
+    printf( "%u events lost\n", lost );
+  }
+  return 0;
+}
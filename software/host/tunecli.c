@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tunecli.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tuning_link.h"
+
+// tunecli port [name | name=value | commit]..., the board's LPUART1 on a serial adapter, or
+// the pty tunesim puts up. each argument is a request in turn, a name reads the word and
+// name=value sets it, with none at all every word is read. stops at the first one that's
+// refused or not answered, with exit status 1
+
+// the firmware only looks at the line while the carriage is still, so longer than a move
+#define REPLY_MS                   6000
+
+static void usage(const char *self) {
+  fprintf( stderr, "usage: %s port [name | name=value | commit]...\nnames:", self );
+  for (unsigned id=0; id<CONFIG_WORDS; id++) {
+    fprintf( stderr, " %s", tuningName( id ) );
+  }
+  fprintf( stderr, "\n" );
+}
+
+static bool request(int fd, const char *arg) {
+  char name[32];
+  uint8_t cmd = TUNING_GET;
+  int32_t value = 0;
+  const char *eq = strchr( arg, '=' );
+  size_t len = eq ? (size_t)(eq - arg) : strlen( arg );
+  if ( len >= sizeof(name) ) {
+    len = sizeof(name) - 1;
+  }
+  memcpy( name, arg, len );
+  name[len] = 0;
+
+  int id = 0;
+  if ( strcmp( name, "commit" ) == 0 && !eq ) {
+    cmd = TUNING_COMMIT;
+  } else if ( (id = tuningId( name )) < 0 ) {
+    fprintf( stderr, "%s: no such word\n", name );
+    return false;
+  } else if ( eq ) {
+    char *end;
+    value = strtol( eq + 1, &end, 0 );
+    if ( !eq[1] || *end ) {
+      fprintf( stderr, "%s: not a number\n", arg );
+      return false;
+    }
+    cmd = TUNING_SET;
+  }
+
+  if ( !tuningRequest( fd, &cmd, id, &value, REPLY_MS ) ) {
+    fprintf( stderr, "%s: no reply\n", name );
+    return false;
+  }
+  if ( cmd & TUNING_REFUSED ) {
+    if ( cmd == (TUNING_COMMIT | TUNING_REFUSED) ) {
+      printf( "commit failed\n" );
+    } else {
+      printf( "%s refused, holds %d\n", name, (int)value );
+    }
+    return false;
+  }
+  if ( cmd == TUNING_COMMIT ) {
+    printf( "committed\n" );
+  } else {
+    printf( "%s %d\n", name, (int)value );
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if ( argc < 2 || argv[1][0] == '-' ) {
+    usage( argv[0] );
+    return 2;
+  }
+  int fd = tuningOpen( argv[1] );
+  if ( fd < 0 ) {
+    perror( argv[1] );
+    return 1;
+  }
+  bool ok = true;
+  if ( argc == 2 ) {
+    for (unsigned id=0; id<CONFIG_WORDS && ok; id++) {
+      ok = request( fd, tuningName( id ) );
+    }
+  }
+  for (int i=2; i<argc && ok; i++) {
+    ok = request( fd, argv[i] );
+  }
+  fflush( stdout );
+  return ok ? 0 : 1;
+}
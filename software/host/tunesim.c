@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tunesim.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "tuning_link.h"
+
+// the whole firmware built with TUNING_UART, with LPUART1 on a pty so tunecli can tune it
+// without a board. it homes onto the switch from reset and then sits at down, nothing plays
+// the wpc89
+//   tunesim                  prints the pty and runs in real time until it's stopped
+//   tunesim check tunecli    runs tunecli against it through the requests in check() below,
+//                            as fast as the sim goes, for `make test`
+#define main firmware_main
+#include "../Core/Src/main.c"
+#undef main
+
+#define LIMIT_AT                   (-50000)
+// the pty is looked at this often, the firmware only polls its ring once a systick anyway
+#define LINK_US                    1000
+
+static int master = -1;
+static bool paced;
+static struct timespec started;
+static pid_t checker;
+
+static void finish(int status);
+
+// the pty both ways, once the firmware has the rx dma up. before that bytes wait in the pty
+// rather than going to an LPUART that would drop them
+static void pty(void) {
+  uint8_t buf[64];
+  if ( LPUART1->CR3 & USART_CR3_DMAR ) {
+    ssize_t n;
+    while ( (n = read( master, buf, sizeof(buf) )) > 0 ) {
+      simUartRx( buf, n );
+    }
+  }
+  size_t len;
+  while ( (len = simUartTx( buf, sizeof(buf) )) ) {
+    if ( write( master, buf, len ) != (ssize_t)len ) {
+      break;
+    }
+  }
+
+  if ( paced ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    int64_t real = (now.tv_sec - started.tv_sec) * 1000000LL + (now.tv_nsec - started.tv_nsec) / 1000;
+    int64_t ahead = (int64_t)(simTime() / SIM_TICKS_PER_US) - real;
+    if ( ahead > 0 ) {
+      usleep( ahead );
+    }
+  }
+  int status;
+  if ( checker && waitpid( checker, &status, WNOHANG ) == checker ) {
+    finish( status );
+  }
+  simAt( simTime() + SIM_US(LINK_US), pty );
+}
+
+// main.c spins on these two with nothing touching a register, the board sits out the pulses
+// or the flash there but here time only goes by when asked. linked in with --wrap
+void __real_stepperWait(void);
+bool __real_eeBusy(void);
+
+void __wrap_stepperWait(void) {
+  while ( stepperBusy() ) {
+    simWait();
+  }
+}
+
+bool __wrap_eeBusy(void) {
+  bool busy = __real_eeBusy();
+  if ( busy ) {
+    simWait();
+  }
+  return busy;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// check, forked off before the firmware runs so config here is still the defaults
+
+static const char *tunecli;
+static const char *port;
+
+// tunecli with args, its exit status and what it printed to either
+static int run(char *out, size_t max, const char *args[]) {
+  const char *argv[8] = { tunecli, port };
+  for (int i=0; args[i]; i++) {
+    argv[i+2] = args[i];
+  }
+  int fds[2];
+  if ( pipe( fds ) ) {
+    return -1;
+  }
+  pid_t pid = fork();
+  if ( pid == 0 ) {
+    dup2( fds[1], 1 );
+    dup2( fds[1], 2 );
+    close( fds[0] );
+    close( fds[1] );
+    execv( tunecli, (char **)argv );
+    perror( tunecli );
+    _exit( 127 );
+  }
+  close( fds[1] );
+  size_t len = 0;
+  ssize_t n;
+  while ( len < max - 1 && (n = read( fds[0], out + len, max - 1 - len )) > 0 ) {
+    len += n;
+  }
+  out[len] = 0;
+  close( fds[0] );
+  int status;
+  waitpid( pid, &status, 0 );
+  return WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+}
+
+#define RUN(want_status, want, ...) do { \
+    char out_[512]; \
+    const char *args_[] = { __VA_ARGS__, NULL }; \
+    int status_ = run( out_, sizeof(out_), args_ ); \
+    CHECK( status_ == (want_status) && strcmp( out_, want ) == 0, "tunecli %s: exit %d\n%s", args_[0], status_, out_ ); \
+  } while (0)
+
+static void check(void) {
+  char all[512];
+  size_t len = 0;
+  int32_t *words = (int32_t *)&config;
+  for (unsigned id=0; id<CONFIG_WORDS; id++) {
+    len += snprintf( all + len, sizeof(all) - len, "%s %d\n", tuningName( id ), (int)words[id] );
+  }
+  const char *none[] = { NULL };
+  char out[512];
+  int status = run( out, sizeof(out), none );
+  CHECK( status == 0 && strcmp( out, all ) == 0, "tunecli: exit %d\n%s", status, out );
+
+  RUN( 1, "speed 1500\naccel refused, holds 8000\n", "speed=1500", "accel=1", "start=20" );
+  RUN( 0, "speed 1500\nstart 100\ncommitted\n", "speed", "start=100", "commit" );
+  RUN( 1, "nonsense: no such word\n", "nonsense" );
+  RUN( 1, "speed=fast: not a number\n", "speed=fast" );
+  exit( simDone( "tunesim check tunecli" ) );
+}
+
+// what the firmware was left with once the checker is done, and what it put in the eeprom
+static void finish(int status) {
+  CHECK( WIFEXITED( status ) && WEXITSTATUS( status ) == 0, "tunesim: checker exit %#x", status );
+  CHECK( config.speed == 1500 && config.start == 100 && config.accel == STEP_ACCEL,
+         "tunesim: speed %u start %u accel %u", (unsigned)config.speed, (unsigned)config.start, (unsigned)config.accel );
+  config_t saved;
+  CHECK( configLoad( &saved ) && memcmp( &saved, &config, sizeof(saved) ) == 0, "tunesim: not saved" );
+  exit( simDone( "tunesim" ) );
+}
+
+int main(int argc, char **argv) {
+  if ( argc != 1 && !(argc == 3 && strcmp( argv[1], "check" ) == 0) ) {
+    fprintf( stderr, "usage: %s [check tunecli]\n", argv[0] );
+    return 2;
+  }
+  master = posix_openpt( O_RDWR | O_NOCTTY );
+  if ( master < 0 || grantpt( master ) || unlockpt( master ) ) {
+    perror( "tunesim: pty" );
+    return 2;
+  }
+  port = ptsname( master );
+  // held open so the pty stays up between tunecli runs, and raw so nothing's done to a byte
+  // before tunecli has it open
+  if ( tuningOpen( port ) < 0 ) {
+    perror( port );
+    return 2;
+  }
+  fcntl( master, F_SETFL, O_NONBLOCK );
+
+  if ( argc == 3 ) {
+    tunecli = argv[2];
+    checker = fork();
+    if ( checker == 0 ) {
+      close( master );
+      check();
+    }
+  } else {
+    // it runs until it's stopped, the watchdog is for the tests
+    alarm( 0 );
+    paced = true;
+    printf( "tunesim: tunecli %s\n", port );
+    fflush( stdout );
+  }
+  clock_gettime( CLOCK_MONOTONIC, &started );
+  simLimit( LIMIT_AT );
+  simAt( 0, pty );
+  firmware_main();
+  return 1;
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tuning_link.c
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "tuning_link.h"
+
+// by id, as config_t lays them out. the cam edges by side, the one nearer down first
+static const char *const names[CONFIG_WORDS] = {
+  "press_steps", "start", "speed", "accel",
+  "right_low", "right_high", "left_low", "left_high",
+};
+
+static uint8_t sum(const uint8_t *frame) {
+  uint8_t s = 0;
+  for (int i=1; i<TUNING_FRAME-1; i++) {
+    s += frame[i];
+  }
+  return ~s;
+}
+
+int tuningOpen(const char *path) {
+  int fd = open( path, O_RDWR | O_NOCTTY );
+  if ( fd < 0 ) {
+    return -1;
+  }
+  // a pty takes the speed and ignores it
+  struct termios t;
+  if ( tcgetattr( fd, &t ) == 0 ) {
+    cfmakeraw( &t );
+    cfsetspeed( &t, B115200 );
+    t.c_cflag |= CLOCAL | CREAD;
+    tcsetattr( fd, TCSANOW, &t );
+  }
+  tcflush( fd, TCIOFLUSH );
+  return fd;
+}
+
+bool tuningRequest(int fd, uint8_t *cmd, uint8_t id, int32_t *value, int timeout_ms) {
+  uint8_t frame[TUNING_FRAME] = { TUNING_SYNC, *cmd, id, *value, *value >> 8, *value >> 16, *value >> 24, 0 };
+  frame[TUNING_FRAME-1] = sum( frame );
+  if ( write( fd, frame, TUNING_FRAME ) != TUNING_FRAME ) {
+    return false;
+  }
+
+  // slid along a byte at a time until a reply lines up, the same as the firmware does
+  uint8_t got[TUNING_FRAME];
+  int have = 0;
+  struct pollfd p = { fd, POLLIN, 0 };
+  while ( poll( &p, 1, timeout_ms ) > 0 ) {
+    ssize_t n = read( fd, got + have, TUNING_FRAME - have );
+    if ( n <= 0 ) {
+      return false;
+    }
+    have += n;
+    while ( have && got[0] != TUNING_REPLY ) {
+      memmove( got, got + 1, --have );
+    }
+    if ( have < TUNING_FRAME ) {
+      continue;
+    }
+    if ( got[TUNING_FRAME-1] != sum( got ) || got[2] != id || (got[1] & ~TUNING_REFUSED) != *cmd ) {
+      memmove( got, got + 1, --have );
+      continue;
+    }
+    *cmd = got[1];
+    *value = got[3] | (got[4] << 8) | (got[5] << 16) | ((uint32_t)got[6] << 24);
+    return true;
+  }
+  return false;
+}
+
+int tuningId(const char *name) {
+  for (unsigned id=0; id<CONFIG_WORDS; id++) {
+    if ( strcmp( name, names[id] ) == 0 ) {
+      return id;
+    }
+  }
+  return -1;
+}
+
+const char *tuningName(uint8_t id) {
+  return id < CONFIG_WORDS ? names[id] : NULL;
+}
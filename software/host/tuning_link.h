@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// tuning_link.h
+// Copyright © 2021 Jeffrey Mathews All rights reserved.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TUNING_LINK_H
+#define __TUNING_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "tuning.h"
+
+// the host end of the protocol in tuning.h, over a serial port or a pty, one request at a
+// time and its reply before the next
+
+// raw 115200 8N1, -1 with errno set if it won't open
+int tuningOpen(const char *path);
+// send a frame and wait up to timeout_ms for the reply, bytes that don't line up as one are
+// skipped. false if none came, *cmd then has what it was sent with and *value is untouched
+bool tuningRequest(int fd, uint8_t *cmd, uint8_t id, int32_t *value, int timeout_ms);
+// the config_t word's id by its name, -1 for none
+int tuningId(const char *name);
+const char *tuningName(uint8_t id);
+
+#endif // __TUNING_LINK_H